@@ -9,13 +9,18 @@
 // License: https://creativecommons.org/licenses/by/4.0/
 
 #include <cstring>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
 
 #include "AudioData.h"
+#include "WavWriter.h"
 
-pthread_mutex_t AudioData::audio_mutex;
+AudioMixer *AudioData::mixer = nullptr;
+SampleFormat AudioData::output_format = SampleFormat::S16;
+bool AudioData::dither = false;
+std::atomic<float> AudioData::sweep_progress(-1.0f);
 
 AudioData::AudioData(int card_number, int sample_freq_Hz, int sample_count, bool use_stereo) :
 	sample_freq_Hz(sample_freq_Hz),
@@ -23,151 +28,242 @@ AudioData::AudioData(int card_number, int sample_freq_Hz, int sample_count, bool
 	use_stereo(use_stereo),
 	Verbose(false),
 	CardNumber(card_number),
-	samplebuffer(std::vector<uint16_t>((use_stereo ? 2 : 1) * sample_count)),
-	volume(-1),
-	newvolume(-1)
+	samplebuffer(std::vector<float>((use_stereo ? 2 : 1) * sample_count)),
+	dither_seed(0)
 {
 }
 
-void AudioData::Init()
+void AudioData::Init(int card_number, int sample_freq_Hz, float speech_ducking, bool verbose, std::string pcm_stream,
+					 SampleFormat output_format, bool dither, const DynamicsParameters &dynamics)
 {
-	pthread_mutex_init(&audio_mutex, NULL);
+	AudioData::output_format = output_format;
+	AudioData::dither = dither;
+
+	//One output stream shared by all AudioData instances:
+	mixer = new AudioMixer(card_number, sample_freq_Hz, verbose, pcm_stream, output_format, dither, dynamics);
+	mixer->SetDucking(speech_ducking);
 }
 
-void AudioData::wi(FILE* fp, uint16_t i)
+void AudioData::Shutdown()
 {
-	int b1, b0;
-	b0 = i % 256;
-	b1 = (i - b0) / 256;
-	putc(b0, fp);
-	putc(b1, fp);
+	delete mixer;
+	mixer = nullptr;
 }
 
-void AudioData::wl(FILE* fp, uint32_t l)
+int AudioData::GetDeviceSampleFreq()
 {
-	unsigned int i1, i0;
-	i0 = l % 65536L;
-	i1 = (l - i0) / 65536L;
-	wi(fp, i0);
-	wi(fp, i1);
+	return mixer->GetSampleFreq();
 }
 
-void AudioData::SaveToWavFile(std::string filename)
+double AudioData::GetResampleTime_ms()
 {
-	FILE *fp;
-	int bytes_per_sample = (use_stereo ? 4 : 2);
-
-	// Write 8/16-bit mono/stereo .wav file
-	fp = fopen(filename.c_str(), "wb");
-	fprintf(fp, "RIFF");
-	wl(fp, sample_count * bytes_per_sample + 36L);
-	fprintf(fp, "WAVEfmt ");
-	wl(fp, 16L);
-	wi(fp, 1);
-	wi(fp, use_stereo ? 2 : 1);
-	wl(fp, 0L + sample_freq_Hz);
-	wl(fp, 0L + sample_freq_Hz * bytes_per_sample);
-	wi(fp, bytes_per_sample);
-	wi(fp, 16);
-	fprintf(fp, "data");
-	wl(fp, sample_count * bytes_per_sample);
-
-	fwrite(samplebuffer.data(), bytes_per_sample, sample_count, fp);
-	fclose(fp);
+	return (mixer != nullptr) ? mixer->GetResampleTime_ms() : 0.0;
+}
+
+void AudioData::SetCrossfade(int crossfade_ms)
+{
+	mixer->SetCrossfade(AudioMixer::Voice::Soundscape, (size_t)crossfade_ms * mixer->GetSampleFreq() / 1000);
 }
 
-void AudioData::Play()
+uint64_t AudioData::GetUnderruns()
 {
-	updateVolume();
-	
-	int bytes_per_sample = (use_stereo ? 4 : 2);
+	return (mixer != nullptr) ? mixer->GetUnderruns() : 0;
+}
+
+uint64_t AudioData::GetOverruns()
+{
+	return (mixer != nullptr) ? mixer->GetOverruns() : 0;
+}
 
-	std::stringstream cmd;
-	cmd << "aplay --nonblock -r" << sample_freq_Hz << " -c" << (use_stereo ? 2 : 1) << " -fS16_LE -D plughw:" << CardNumber;
-	if (!Verbose)
+float AudioData::GetPlayProgress()
+{
+	if (mixer == nullptr)
 	{
-		cmd << " -q";
+		return -1.0;
 	}
-	else
+	float progress = sweep_progress.load();
+	if (progress >= 0.0)
 	{
-		std::cout << cmd.str() << std::endl;
+		return progress;
 	}
+	return mixer->GetPlayProgress(AudioMixer::Voice::Soundscape);
+}
 
-	pthread_mutex_lock(&audio_mutex);
-	FILE* p = popen(cmd.str().c_str(), "w");
-	fwrite(samplebuffer.data(), bytes_per_sample, sample_count, p);
-	pclose(p);
-	pthread_mutex_unlock(&audio_mutex);
+void AudioData::SetSweepProgress(float progress)
+{
+	sweep_progress.store(progress);
 }
 
-int AudioData::PlayWav(std::string filename)
+void AudioData::QueueSoundscape(const float *samples, int frame_count, int sample_freq_Hz, int channels)
 {
-	char command[256] = "";
-	int status;
-	snprintf(command, 256, "aplay %s -D hw:%d", filename.c_str(), CardNumber);
-	pthread_mutex_lock(&audio_mutex);
-	status = system(command);
-	pthread_mutex_unlock(&audio_mutex);
-	return status;
+	mixer->WaitUntilPlayed(AudioMixer::Voice::Soundscape, 2 * mixer->GetPeriodFrames());
+	mixer->Submit(AudioMixer::Voice::Soundscape, samples, frame_count, channels, sample_freq_Hz);
 }
 
-void AudioData::SetVolume(int newvolume)
+void AudioData::SaveToWavFile(std::string filename)
 {
-	this->newvolume = newvolume;
+	WavWriter writer;
+	if (writer.Open(filename, sample_freq_Hz, use_stereo ? 2 : 1, output_format))
+	{
+		writer.Write(samplebuffer.data(), sample_count, dither ? &dither_seed : nullptr);
+	}
 }
 
-int AudioData::updateVolume()
+void AudioData::Play(int lead_frames)
 {
-	if ((volume == newvolume) || (newvolume == -1))
+	if (Verbose)
 	{
-		return 0;
+		std::cout << "Mixing " << sample_count << " frames, soundscape" << std::endl;
 	}
 
-	volume = newvolume;
+	mixer->Submit(AudioMixer::Voice::Soundscape, samplebuffer.data(), sample_count, use_stereo ? 2 : 1, sample_freq_Hz);
+	WaitUntilPlayed(lead_frames);
+}
 
-	char command[256] = "";
-	int status = 0;
-	snprintf(command, 256, "amixer -c %d controls | grep MIXER | grep Playback | grep Volume | sed s/[^0-9]*//g", CardNumber);
-	//std::cout << command << std::endl;
+void AudioData::PlayPart(int first_frame, int frame_count)
+{
+	int channels = use_stereo ? 2 : 1;
+	const float *samples = &samplebuffer[(size_t)first_frame * channels];
+	if (first_frame == 0)
+	{
+		mixer->Submit(AudioMixer::Voice::Soundscape, samples, frame_count, channels, sample_freq_Hz);
+	}
+	else
+	{
+		mixer->Append(AudioMixer::Voice::Soundscape, samples, frame_count, channels, sample_freq_Hz);
+	}
+}
 
-	pthread_mutex_lock(&audio_mutex);
-	FILE *fp = popen(command, "r");
-	if (fp == nullptr)
+void AudioData::WaitUntilPlayed(int lead_frames)
+{
+	mixer->WaitUntilPlayed(AudioMixer::Voice::Soundscape, (size_t)((int64_t)lead_frames * mixer->GetSampleFreq() / sample_freq_Hz));
+}
+
+void AudioData::PlayPcm(const int16_t *samples, int frame_count, int sample_freq_Hz, int channels, AudioMixer::Voice voice)
+{
+	if (Verbose)
 	{
-		return -1;
+		std::cout << "Mixing " << frame_count << " frames, voice " << (int)voice << std::endl;
 	}
-	char buffer[256];
-	char *res;
-	while (!feof(fp) && status == 0)
+
+	//Other voices keep playing, only wait for this one:
+	mixer->Submit(voice, samples, frame_count, channels, sample_freq_Hz);
+	mixer->WaitUntilPlayed(voice);
+}
+
+bool AudioData::readWav(FILE *fp, std::vector<int16_t> &samples, int &sample_freq_Hz, int &channels)
+{
+	char id[4];
+	uint32_t size;
+	uint16_t format = 0, bits = 0;
+
+	if ((fread(id, 1, 4, fp) != 4) || (strncmp(id, "RIFF", 4) != 0) || (fread(&size, 4, 1, fp) != 1)
+		|| (fread(id, 1, 4, fp) != 4) || (strncmp(id, "WAVE", 4) != 0))
+	{
+		return false;
+	}
+
+	while ((fread(id, 1, 4, fp) == 4) && (fread(&size, 4, 1, fp) == 1))
+	{
+		if (strncmp(id, "fmt ", 4) == 0)
 		{
-		res = fgets(buffer, sizeof(buffer), fp);
-		if ((res == nullptr) || atoi(res) == 0)
+			uint8_t fmt[16];
+			if ((size < 16) || (fread(fmt, 1, 16, fp) != 16))
+			{
+				return false;
+			}
+			format = fmt[0] | (fmt[1] << 8);
+			channels = fmt[2] | (fmt[3] << 8);
+			sample_freq_Hz = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+			bits = fmt[14] | (fmt[15] << 8);
+			//Chunks are padded to even sizes:
+			for (uint64_t i = 16; i < (uint64_t)size + (size & 1); i++)
+			{
+				fgetc(fp);
+			}
+		}
+		else if (strncmp(id, "data", 4) == 0)
 		{
-			status = -1;
+			if ((format != 1) || (bits != 16) || (channels < 1))
+			{
+				return false;
+			}
+
+			//Streamed WAV (e.g. espeak --stdout) has a placeholder size, read to the end. Otherwise only the
+			//chunk is read, any chunks after it are no audio:
+			bool streamed = (size == 0) || (size >= 0x7ffff000);
+			size_t sample_count = size / 2;
+			int16_t buffer[4096];
+			size_t n;
+			while (streamed || (samples.size() < sample_count))
+			{
+				size_t count = streamed ? 4096 : std::min((size_t)4096, sample_count - samples.size());
+				if ((n = fread(buffer, 2, count, fp)) == 0)
+				{
+					break;
+				}
+				samples.insert(samples.end(), buffer, buffer + n);
+			}
+			return !samples.empty();
 		}
 		else
 		{
-			int numid = atoi(res);
-			snprintf(command, sizeof(command), "amixer -c %d cset numid=%d %d%% -q", CardNumber, numid, newvolume);
-			//std::cout << command << std::endl;
-
-			status = system(command);
+			for (uint64_t i = 0; i < (uint64_t)size + (size & 1); i++)
+			{
+				fgetc(fp);
+			}
 		}
 	}
-	pclose(fp);
-	pthread_mutex_unlock(&audio_mutex);
-	return status;
+
+	return false;
 }
 
-bool AudioData::Speak(std::string text)
+int AudioData::PlayWav(std::string filename)
 {
-	updateVolume();
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (fp == NULL)
+	{
+		return -1;
+	}
 
+	std::vector<int16_t> samples;
+	int wav_freq_Hz, channels;
+	bool ok = readWav(fp, samples, wav_freq_Hz, channels);
+	fclose(fp);
+
+	if (!ok)
+	{
+		return -1;
+	}
+
+	PlayPcm(samples.data(), samples.size() / channels, wav_freq_Hz, channels, AudioMixer::Voice::Cue);
+	return 0;
+}
+
+void AudioData::SetVolume(int newvolume)
+{
+	mixer->SetVolume(newvolume);
+}
+
+bool AudioData::Speak(std::string text)
+{
 	char command[1023] = "";
-	int status;
-	snprintf(command, 1023, "espeak --stdout \"%s\" | aplay -q -D plughw:%d", text.c_str(), CardNumber);
-	pthread_mutex_lock(&audio_mutex);
-	int res = system(command);
-	pthread_mutex_unlock(&audio_mutex);
-	return (res == 0);
+	snprintf(command, 1023, "espeak --stdout \"%s\"", text.c_str());
+
+	FILE *fp = popen(command, "r");
+	if (fp == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<int16_t> samples;
+	int wav_freq_Hz, channels;
+	bool ok = readWav(fp, samples, wav_freq_Hz, channels);
+	int res = pclose(fp);
+
+	if (ok)
+	{
+		PlayPcm(samples.data(), samples.size() / channels, wav_freq_Hz, channels, AudioMixer::Voice::Speech);
+	}
+	return ok && (res == 0);
 }
@@ -4,6 +4,9 @@
 #include <string>
 #include <cstdio>
 #include <cinttypes>
+#include <atomic>
+
+#include "AudioMixer.h"
 
 class AudioData
 {
@@ -11,26 +14,55 @@ private:
 	const bool use_stereo;
 	const int sample_freq_Hz;
 	const int sample_count;
-	std::vector<uint16_t> samplebuffer;
-	static pthread_mutex_t audio_mutex;
-	int volume;
-	int newvolume;
+	std::vector<float> samplebuffer; //full scale +-1.0, not clipped
+	uint32_t dither_seed;
+	static AudioMixer *mixer;
+	static SampleFormat output_format;
+	static bool dither;
+	static std::atomic<float> sweep_progress;
 
-	void wi(FILE* fp, uint16_t i);
-	void wl(FILE* fp, uint32_t l);
-	int updateVolume();
+	static bool readWav(FILE *fp, std::vector<int16_t> &samples, int &sample_freq_Hz, int &channels);
 public:
 	int CardNumber;
 	bool Verbose;
 
-	static void Init();
+	//output_format: of the device (if it takes it, see AudioMixer) and of WAV files. dither: when reducing to 16 bits.
+	//dynamics: limiter and AGC of the device output, WAV files are not affected.
+	static void Init(int card_number, int sample_freq_Hz, float speech_ducking = 1.0, bool verbose = false, std::string pcm_stream = "",
+					 SampleFormat output_format = SampleFormat::S16, bool dither = false, const DynamicsParameters &dynamics = DynamicsParameters());
+	static void Shutdown();
+	//Rate negotiated with the audio device, soundscapes rendered at this rate are not resampled.
+	static int GetDeviceSampleFreq();
+	//Time of the last resampling of speech or cues, see AudioMixer::GetResampleTime_ms().
+	static double GetResampleTime_ms();
+	//Overlap of consecutive soundscapes, the next one is faded in (0: none). See AudioMixer::SetCrossfade().
+	static void SetCrossfade(int crossfade_ms);
+	static uint64_t GetUnderruns();
+	static uint64_t GetOverruns();
+	//Position within the soundscape being played (0.0-1.0), -1.0 if none.
+	static float GetPlayProgress();
+	//Continuous sweep: the soundscape is queued in pieces, so its position is set by the caller (-1.0: none).
+	static void SetSweepProgress(float progress);
+	//Queues a piece of a continuous soundscape once the queue is down to about two mixer periods, so
+	//the next piece can be rendered as late as possible without gaps.
+	static void QueueSoundscape(const float *samples, int frame_count, int sample_freq_Hz, int channels);
 	AudioData(int card_number, int sample_freq_Hz = 48000, int sample_count = 0, bool use_stereo = true);
 	
-	uint16_t *Data() { return &samplebuffer[0]; };
+	float *Data() { return &samplebuffer[0]; };
+	int GetFrameCount() { return sample_count; }
+	int GetChannels() { return use_stereo ? 2 : 1; }
+	int GetSampleFreq() { return sample_freq_Hz; }
 
 	void SaveToWavFile(std::string filename);
 	
-	void Play();
+	//Returns once at most lead_frames are left to play, so the next soundscape can be rendered meanwhile.
+	//The samples are copied to the mixer, Data() may be overwritten right away.
+	void Play(int lead_frames = 0);
+	//Queues frames [first_frame, first_frame + frame_count) as they are rendered, parts after the first one are
+	//joined to it in the mixer. Returns immediately, WaitUntilPlayed() then takes the place of Play().
+	void PlayPart(int first_frame, int frame_count);
+	void WaitUntilPlayed(int lead_frames = 0);
+	void PlayPcm(const int16_t *samples, int frame_count, int sample_freq_Hz, int channels, AudioMixer::Voice voice);
 	int PlayWav(std::string filename);
 	void SetVolume(int newvolume);
 	bool Speak(std::string text);
@@ -0,0 +1,723 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+#include <cerrno>
+
+#include "AudioMixer.h"
+#include "SampleConversion.h"
+#include "printtime.h"
+
+AudioMixer::AudioMixer(int card_number, int sample_freq_Hz, bool verbose, std::string pcm_stream, SampleFormat format, bool dither,
+					   const DynamicsParameters &dynamics) :
+	card_number(card_number),
+	sample_freq_Hz(sample_freq_Hz),
+	verbose(verbose),
+	pcm(nullptr),
+	period_frames(1024),
+	requested_format(format),
+	device_format(format),
+	dither(dither),
+	dither_seed(0),
+	mixer(nullptr),
+	volume_elem(nullptr),
+	volume_min(0),
+	volume_max(0),
+	master_gain(1.0),
+	period_master_gain(1.0),
+	duck_gain(1.0),
+	current_duck_gain(1.0),
+	current_agc_gain(1.0),
+	quit(false),
+	resample_ms(0.0),
+	underruns(0),
+	overruns(0)
+{
+	for (int v = 0; v < (int)Voice::Count; v++)
+	{
+		voices[v].position = 0;
+		voices[v].pending_frames = 0;
+		voices[v].crossfade_frames = 0;
+		voices[v].crossfading = false;
+		voices[v].starved = false;
+		voices[v].gain = 1.0;
+	}
+
+	//Before any text output, as streaming to stdout moves text output to stderr. The stream has the device rate:
+	openDevice();
+	if (pcm_stream != "")
+	{
+		stream_sink.reset(new PcmStreamSink(pcm_stream, this->sample_freq_Hz, 2, 1000, verbose));
+	}
+
+	if (verbose && (pcm != nullptr))
+	{
+		std::cout << "Audio device " << device_name << " opened, " << this->sample_freq_Hz << " Hz, " << GetSampleFormatName(device_format);
+		if (device_format != requested_format)
+		{
+			std::cout << " (" << GetSampleFormatName(requested_format) << " not supported)";
+		}
+		std::cout << ", period " << period_frames << " frames" << std::endl;
+	}
+	openVolumeControl();
+
+	mixbuffer.resize(2 * period_frames);
+	if (dynamics.limiter)
+	{
+		limiter.reset(new PeakLimiter(this->sample_freq_Hz, period_frames, dynamics.ceiling_dB, dynamics.lookahead_ms, dynamics.release_ms));
+	}
+	if (dynamics.agc)
+	{
+		agc.reset(new AutoGain(this->sample_freq_Hz, dynamics.agc_target_dB, dynamics.agc_max_gain_dB, dynamics.agc_time_s));
+	}
+	outbuffer.resize(2 * period_frames * GetSampleBytes(device_format));
+	if (stream_sink && (device_format != SampleFormat::S16))
+	{
+		streambuffer.resize(2 * period_frames);
+	}
+
+	pthread_mutex_init(&mixer_mutex, NULL);
+	pthread_mutex_init(&volume_mutex, NULL);
+	pthread_cond_init(&mixer_cond, NULL);
+
+	if (pthread_create(&mixer_thread, NULL, runMixerThread, this))
+	{
+		throw(std::runtime_error("Error setting up audio mixer thread."));
+	}
+}
+
+AudioMixer::~AudioMixer()
+{
+	pthread_mutex_lock(&mixer_mutex);
+	quit = true;
+	pthread_cond_broadcast(&mixer_cond);
+	pthread_mutex_unlock(&mixer_mutex);
+
+	pthread_join(mixer_thread, nullptr);
+
+	if (pcm != nullptr)
+	{
+		snd_pcm_drain(pcm);
+		snd_pcm_close(pcm);
+	}
+
+	if (mixer != nullptr)
+	{
+		snd_mixer_close(mixer);
+	}
+
+	pthread_cond_destroy(&mixer_cond);
+	pthread_mutex_destroy(&volume_mutex);
+	pthread_mutex_destroy(&mixer_mutex);
+}
+
+static snd_pcm_format_t alsaFormat(SampleFormat format)
+{
+	switch (format)
+	{
+		case SampleFormat::S24:
+			return SND_PCM_FORMAT_S24_3LE;
+		case SampleFormat::S32:
+			return SND_PCM_FORMAT_S32_LE;
+		case SampleFormat::Float:
+			return SND_PCM_FORMAT_FLOAT_LE;
+		default:
+			return SND_PCM_FORMAT_S16_LE;
+	}
+}
+
+//The requested format if the hardware takes it, otherwise the native format with the most resolution.
+SampleFormat AudioMixer::negotiateFormat(snd_pcm_hw_params_t *params)
+{
+	SampleFormat candidates[] = { requested_format, SampleFormat::Float, SampleFormat::S32, SampleFormat::S24, SampleFormat::S16 };
+	for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+	{
+		if (snd_pcm_hw_params_test_format(pcm, params, alsaFormat(candidates[i])) == 0)
+		{
+			return candidates[i];
+		}
+	}
+	return requested_format;
+}
+
+//hw: without any conversion layer, format and rate are negotiated with the card.
+int AudioMixer::openHwDevice(std::string device)
+{
+	int err = snd_pcm_open(&pcm, device.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0)
+	{
+		pcm = nullptr;
+		return err;
+	}
+
+	snd_pcm_hw_params_t *params;
+	err = snd_pcm_hw_params_malloc(&params);
+	if (err < 0)
+	{
+		return err;
+	}
+
+	unsigned int rate = sample_freq_Hz;
+	//100 ms device buffer in 4 periods, the mixer writes one period at a time:
+	snd_pcm_uframes_t period = sample_freq_Hz / 40;
+	snd_pcm_uframes_t buffer = 4 * period;
+	if ((err = snd_pcm_hw_params_any(pcm, params)) >= 0)
+	{
+		device_format = negotiateFormat(params);
+		if (((err = snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0) &&
+			((err = snd_pcm_hw_params_set_format(pcm, params, alsaFormat(device_format))) >= 0) &&
+			((err = snd_pcm_hw_params_set_channels(pcm, params, 2)) >= 0) &&
+			((err = snd_pcm_hw_params_set_rate_resample(pcm, params, 0)) >= 0) &&
+			((err = snd_pcm_hw_params_set_rate_near(pcm, params, &rate, 0)) >= 0) &&
+			((err = snd_pcm_hw_params_set_period_size_near(pcm, params, &period, 0)) >= 0) &&
+			((err = snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer)) >= 0) &&
+			((err = snd_pcm_hw_params(pcm, params)) >= 0))
+		{
+			err = snd_pcm_hw_params_get_period_size(params, &period_frames, 0);
+		}
+	}
+	snd_pcm_hw_params_free(params);
+
+	if (err >= 0)
+	{
+		sample_freq_Hz = rate;
+	}
+	return err;
+}
+
+void AudioMixer::openDevice()
+{
+	std::stringstream hw_device;
+	hw_device << "hw:" << card_number;
+	device_name = hw_device.str();
+	int err = openHwDevice(device_name);
+
+	if (err < 0)
+	{
+		//E.g. a mono card: plughw: for the channels, still without format conversion.
+		if (pcm != nullptr)
+		{
+			snd_pcm_close(pcm);
+			pcm = nullptr;
+		}
+		std::stringstream plug_device;
+		plug_device << "plughw:" << card_number;
+		device_name = plug_device.str();
+
+		err = snd_pcm_open(&pcm, device_name.c_str(), SND_PCM_STREAM_PLAYBACK, SND_PCM_NO_AUTO_FORMAT);
+		if (err >= 0)
+		{
+			snd_pcm_hw_params_t *params;
+			if (snd_pcm_hw_params_malloc(&params) >= 0)
+			{
+				if (snd_pcm_hw_params_any(pcm, params) >= 0)
+				{
+					device_format = negotiateFormat(params);
+				}
+				snd_pcm_hw_params_free(params);
+			}
+			err = snd_pcm_set_params(pcm, alsaFormat(device_format), SND_PCM_ACCESS_RW_INTERLEAVED, 2, sample_freq_Hz, 1, 100000);
+		}
+		if (err >= 0)
+		{
+			snd_pcm_uframes_t buffer_frames;
+			err = snd_pcm_get_params(pcm, &buffer_frames, &period_frames);
+		}
+	}
+
+	if (err < 0)
+	{
+		//Keep running without output, paced by the system clock:
+		std::cerr << "Cannot open audio device " << device_name << ": " << snd_strerror(err) << std::endl;
+		if (pcm != nullptr)
+		{
+			snd_pcm_close(pcm);
+			pcm = nullptr;
+		}
+		device_format = requested_format;
+		period_frames = sample_freq_Hz / 50;
+	}
+}
+
+void AudioMixer::openVolumeControl()
+{
+	std::stringstream device;
+	device << "hw:" << card_number;
+
+	if ((snd_mixer_open(&mixer, 0) < 0) || (snd_mixer_attach(mixer, device.str().c_str()) < 0)
+		|| (snd_mixer_selem_register(mixer, NULL, NULL) < 0) || (snd_mixer_load(mixer) < 0))
+	{
+		if (mixer != nullptr)
+		{
+			snd_mixer_close(mixer);
+			mixer = nullptr;
+		}
+	}
+	else
+	{
+		//Prefer the usual main controls, otherwise take the first playback volume:
+		const char *preferred[] = { "PCM", "Master", "Speaker", "Headphone" };
+		int best_rank = sizeof(preferred) / sizeof(preferred[0]);
+		for (snd_mixer_elem_t *elem = snd_mixer_first_elem(mixer); elem != NULL; elem = snd_mixer_elem_next(elem))
+		{
+			if (!snd_mixer_selem_is_active(elem) || !snd_mixer_selem_has_playback_volume(elem))
+			{
+				continue;
+			}
+
+			int rank = best_rank;
+			for (int i = 0; i < best_rank; i++)
+			{
+				if (std::string(snd_mixer_selem_get_name(elem)) == preferred[i])
+				{
+					rank = i;
+				}
+			}
+			if ((volume_elem == nullptr) || (rank < best_rank))
+			{
+				volume_elem = elem;
+				best_rank = rank;
+			}
+		}
+	}
+
+	if (volume_elem != nullptr)
+	{
+		snd_mixer_selem_get_playback_volume_range(volume_elem, &volume_min, &volume_max);
+		if (verbose)
+		{
+			std::cout << "Volume control: " << snd_mixer_selem_get_name(volume_elem) << std::endl;
+		}
+	}
+	else if (verbose)
+	{
+		std::cout << "No hardware volume control on " << device.str() << ", using software gain" << std::endl;
+	}
+}
+
+void *AudioMixer::runMixerThread(void *arg)
+{
+	static_cast<AudioMixer*>(arg)->mixerLoop();
+	return nullptr;
+}
+
+void AudioMixer::mixerLoop()
+{
+	pthread_mutex_lock(&mixer_mutex);
+	while (!quit)
+	{
+		mixPeriod();
+		pthread_cond_broadcast(&mixer_cond);
+		pthread_mutex_unlock(&mixer_mutex);
+
+		writePeriod();
+
+		pthread_mutex_lock(&mixer_mutex);
+	}
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+//mixer_mutex must be locked.
+void AudioMixer::mixPeriod()
+{
+	std::fill(mixbuffer.begin(), mixbuffer.end(), 0.0f);
+
+	//Soundscape is ducked while speech or cues are playing, with ~20 ms ramps:
+	bool overlay_active = (voices[(int)Voice::Speech].pending_frames > 0) || (voices[(int)Voice::Cue].pending_frames > 0);
+	float target_duck_gain = overlay_active ? duck_gain : 1.0;
+	float ramp = 1.0 - exp(-1.0 / (0.02 * sample_freq_Hz));
+	//AGC gain from the previous periods, also ramped:
+	float target_agc_gain = agc ? agc->GetGain() : 1.0f;
+	double sum_of_squares = 0.0;
+	size_t measured_frames = 0;
+
+	for (int v = 0; v < (int)Voice::Count; v++)
+	{
+		VoiceState &voice = voices[v];
+		size_t frame = 0;
+		while ((frame < period_frames) && !voice.buffers.empty())
+		{
+			const std::vector<float> &buffer = voice.buffers.front();
+			size_t buffer_frames = buffer.size() / 2;
+			size_t n = std::min(period_frames - frame, buffer_frames - voice.position);
+			const float *src = &buffer[2 * voice.position];
+			float *dst = &mixbuffer[2 * frame];
+
+			//The next buffer fades in over the last crossfade_frames of this one, if it is there in time:
+			size_t fade_frames = std::min(voice.crossfade_frames, buffer_frames / 2);
+			size_t fade_start = buffer_frames - fade_frames;
+			if (fade_frames > 0)
+			{
+				if (voice.position < fade_start)
+				{
+					n = std::min(n, fade_start - voice.position);
+				}
+				else if (voice.position == fade_start)
+				{
+					voice.crossfading = (voice.buffers.size() > 1) && (voice.buffers[1].size() / 2 >= fade_frames);
+				}
+			}
+			const float *next = nullptr;
+			if (voice.crossfading && (voice.position >= fade_start))
+			{
+				next = &voice.buffers[1][2 * (voice.position - fade_start)];
+			}
+
+			if (v == (int)Voice::Soundscape)
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					current_duck_gain += (target_duck_gain - current_duck_gain) * ramp;
+					current_agc_gain += (target_agc_gain - current_agc_gain) * ramp;
+					float g = voice.gain * current_duck_gain * current_agc_gain;
+					float l = src[2 * i];
+					float r = src[2 * i + 1];
+					if (next != nullptr)
+					{
+						//Equal gain, the soundscapes are correlated in the unchanged parts of the image:
+						float w = (voice.position - fade_start + i + 0.5f) / fade_frames;
+						l += w * (next[2 * i] - l);
+						r += w * (next[2 * i + 1] - r);
+					}
+					sum_of_squares += l * l + r * r;
+					dst[2 * i] += g * l;
+					dst[2 * i + 1] += g * r;
+				}
+				measured_frames += n;
+			}
+			else
+			{
+				for (size_t i = 0; i < 2 * n; i++)
+				{
+					dst[i] += voice.gain * src[i];
+				}
+			}
+
+			frame += n;
+			voice.position += n;
+			voice.pending_frames -= (next != nullptr) ? 2 * n : n;
+			if (voice.position >= buffer_frames)
+			{
+				recycleBuffer(voice.buffers.front());
+				voice.buffers.pop_front();
+				//The faded-in part of the next buffer has been played already:
+				voice.position = voice.crossfading ? fade_frames : 0;
+				voice.crossfading = false;
+				if (voice.buffers.empty() && (v == (int)Voice::Soundscape))
+				{
+					voice.starved = true;
+				}
+			}
+		}
+	}
+
+	if (voices[(int)Voice::Soundscape].buffers.empty())
+	{
+		current_duck_gain = target_duck_gain;
+		current_agc_gain = target_agc_gain;
+	}
+	if (agc)
+	{
+		agc->Measure(sum_of_squares, measured_frames, 2);
+	}
+
+	period_master_gain = master_gain;
+}
+
+void AudioMixer::writePeriod()
+{
+	uint32_t *seed = dither ? &dither_seed : nullptr;
+	float gain = period_master_gain;
+	if (limiter)
+	{
+		//Limited after the volume, right before quantization:
+		for (size_t i = 0; i < mixbuffer.size(); i++)
+		{
+			mixbuffer[i] *= gain;
+		}
+		limiter->Process(mixbuffer.data(), period_frames);
+		gain = 1.0f;
+	}
+	ConvertSamples(mixbuffer.data(), outbuffer.data(), mixbuffer.size(), device_format, gain, seed);
+
+	if (stream_sink)
+	{
+		//The stream is always 16 bits:
+		if (device_format == SampleFormat::S16)
+		{
+			stream_sink->Write((const int16_t*)outbuffer.data(), period_frames);
+		}
+		else
+		{
+			ConvertSamples(mixbuffer.data(), streambuffer.data(), mixbuffer.size(), SampleFormat::S16, gain, seed);
+			stream_sink->Write(streambuffer.data(), period_frames);
+		}
+	}
+
+	if (pcm == nullptr)
+	{
+		struct timespec period = { 0, (long)(1.0e9 * period_frames / sample_freq_Hz) };
+		nanosleep(&period, NULL);
+		return;
+	}
+
+	const uint8_t *data = outbuffer.data();
+	size_t bytes_per_frame = 2 * GetSampleBytes(device_format);
+	snd_pcm_uframes_t remaining = period_frames;
+	while (remaining > 0)
+	{
+		snd_pcm_sframes_t written = snd_pcm_writei(pcm, data, remaining);
+		if (written < 0)
+		{
+			if (written == -EPIPE)
+			{
+				underruns++;
+			}
+			written = snd_pcm_recover(pcm, written, verbose ? 0 : 1);
+			if (written < 0)
+			{
+				std::cerr << "Audio write error: " << snd_strerror(written) << std::endl;
+				return;
+			}
+			continue;
+		}
+		data += bytes_per_frame * written;
+		remaining -= written;
+	}
+}
+
+static inline float sampleValue(int16_t sample)
+{
+	return sample * (1.0f / 32768.0f);
+}
+
+static inline float sampleValue(float sample)
+{
+	return sample;
+}
+
+void AudioMixer::Submit(Voice voice, const int16_t *samples, int frame_count, int channels, int sample_freq_Hz)
+{
+	submit(voice, samples, frame_count, channels, sample_freq_Hz, false);
+}
+
+void AudioMixer::Submit(Voice voice, const float *samples, int frame_count, int channels, int sample_freq_Hz)
+{
+	submit(voice, samples, frame_count, channels, sample_freq_Hz, false);
+}
+
+void AudioMixer::Append(Voice voice, const float *samples, int frame_count, int channels, int sample_freq_Hz)
+{
+	submit(voice, samples, frame_count, channels, sample_freq_Hz, true);
+}
+
+template<typename T>
+void AudioMixer::submit(Voice voice, const T *samples, int frame_count, int channels, int sample_freq_Hz, bool append)
+{
+	if (frame_count <= 0)
+	{
+		return;
+	}
+
+	std::shared_ptr<Resampler> resampler;
+	std::vector<float> buffer;
+	pthread_mutex_lock(&mixer_mutex);
+	if (sample_freq_Hz != this->sample_freq_Hz)
+	{
+		resampler = getResampler(sample_freq_Hz);
+	}
+	if (!free_buffers.empty())
+	{
+		buffer.swap(free_buffers.back());
+		free_buffers.pop_back();
+	}
+	pthread_mutex_unlock(&mixer_mutex);
+
+	//Convert to stereo float at the mixer rate:
+	int right = (channels > 1) ? 1 : 0;
+	size_t out_frames = frame_count;
+	if (!resampler)
+	{
+		buffer.resize(2 * out_frames);
+		for (size_t k = 0; k < out_frames; k++)
+		{
+			buffer[2 * k] = sampleValue(samples[k * channels]);
+			buffer[2 * k + 1] = sampleValue(samples[k * channels + right]);
+		}
+	}
+	else
+	{
+		StageTimer timer;
+		std::vector<float> in(frame_count * channels);
+		for (size_t i = 0; i < in.size(); i++)
+		{
+			in[i] = sampleValue(samples[i]);
+		}
+		out_frames = resampler->GetOutputFrames(frame_count);
+		buffer.resize(2 * out_frames);
+		resampler->Process(&in[0], frame_count, channels, &buffer[0], 2);
+		resampler->Process(&in[right], frame_count, channels, &buffer[1], 2);
+		double ms = timer.Lap();
+		resample_ms = ms;
+
+		if (verbose)
+		{
+			std::cout << "Resampled " << frame_count << " frames " << sample_freq_Hz << " -> " << this->sample_freq_Hz << " Hz in " << ms << " ms" << std::endl;
+		}
+	}
+
+	pthread_mutex_lock(&mixer_mutex);
+	VoiceState &v = voices[(int)voice];
+	if (v.starved)
+	{
+		//The stream ran dry before this buffer came:
+		underruns++;
+		v.starved = false;
+	}
+	if (append && !v.buffers.empty())
+	{
+		//Part of a soundscape that is queued already, it is not dropped on overrun:
+		v.buffers.back().insert(v.buffers.back().end(), buffer.begin(), buffer.end());
+		v.pending_frames += out_frames;
+		recycleBuffer(buffer);
+		pthread_mutex_unlock(&mixer_mutex);
+		return;
+	}
+	if (voice == Voice::Soundscape)
+	{
+		//Bounded latency: waiting soundscapes are dropped, oldest first. The playing one is finished, and so is
+		//the one being faded in, part of which has been played already:
+		size_t first_waiting = v.crossfading ? 2 : 1;
+		while ((v.buffers.size() > first_waiting) && (v.pending_frames + out_frames > (size_t)maxQueuedSeconds * this->sample_freq_Hz))
+		{
+			size_t dropped_frames = v.buffers[first_waiting].size() / 2;
+			recycleBuffer(v.buffers[first_waiting]);
+			v.buffers.erase(v.buffers.begin() + first_waiting);
+			v.pending_frames -= dropped_frames;
+			overruns++;
+		}
+	}
+	v.buffers.push_back(std::vector<float>());
+	v.buffers.back().swap(buffer);
+	v.pending_frames += out_frames;
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+//Resamplers are kept per input rate, the filter design is done once. Call with mixer_mutex held.
+std::shared_ptr<Resampler> AudioMixer::getResampler(int in_freq_Hz)
+{
+	std::shared_ptr<Resampler> &resampler = resamplers[in_freq_Hz];
+	if (!resampler)
+	{
+		resampler.reset(new Resampler(in_freq_Hz, sample_freq_Hz));
+	}
+	return resampler;
+}
+
+//Mixed buffers are kept for the next Submit(), so steady playback does not allocate. Call with mixer_mutex held.
+void AudioMixer::recycleBuffer(std::vector<float> &buffer)
+{
+	if (free_buffers.size() < maxFreeBuffers)
+	{
+		free_buffers.push_back(std::vector<float>());
+		free_buffers.back().swap(buffer);
+	}
+}
+
+void AudioMixer::WaitUntilPlayed(Voice voice, size_t max_pending_frames)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	while ((voices[(int)voice].pending_frames > max_pending_frames) && !quit)
+	{
+		pthread_cond_wait(&mixer_cond, &mixer_mutex);
+	}
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+void AudioMixer::Flush(Voice voice)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	VoiceState &v = voices[(int)voice];
+	v.buffers.clear();
+	v.position = 0;
+	v.pending_frames = 0;
+	v.crossfading = false;
+	v.starved = false;
+	pthread_cond_broadcast(&mixer_cond);
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+bool AudioMixer::IsActive(Voice voice)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	bool active = (voices[(int)voice].pending_frames > 0);
+	pthread_mutex_unlock(&mixer_mutex);
+	return active;
+}
+
+float AudioMixer::GetPlayProgress(Voice voice)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	VoiceState &v = voices[(int)voice];
+	float progress = -1.0;
+	if (!v.buffers.empty())
+	{
+		progress = (float)v.position / (v.buffers.front().size() / 2);
+	}
+	pthread_mutex_unlock(&mixer_mutex);
+	return progress;
+}
+
+void AudioMixer::SetGain(Voice voice, float gain)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	voices[(int)voice].gain = gain;
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+void AudioMixer::SetCrossfade(Voice voice, size_t frames)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	voices[(int)voice].crossfade_frames = frames;
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+void AudioMixer::SetDucking(float duck_gain)
+{
+	pthread_mutex_lock(&mixer_mutex);
+	this->duck_gain = duck_gain;
+	pthread_mutex_unlock(&mixer_mutex);
+}
+
+void AudioMixer::SetVolume(int percent)
+{
+	if (percent < 0)
+	{
+		percent = 0;
+	}
+	else if (percent > 100)
+	{
+		percent = 100;
+	}
+
+	pthread_mutex_lock(&volume_mutex);
+	if (volume_elem != nullptr)
+	{
+		long value = volume_min + (volume_max - volume_min) * percent / 100;
+		int err = snd_mixer_selem_set_playback_volume_all(volume_elem, value);
+		if ((err < 0) && verbose)
+		{
+			std::cout << "Cannot set volume: " << snd_strerror(err) << std::endl;
+		}
+	}
+	pthread_mutex_unlock(&volume_mutex);
+
+	if (volume_elem == nullptr)
+	{
+		pthread_mutex_lock(&mixer_mutex);
+		master_gain = percent / 100.0;
+		pthread_mutex_unlock(&mixer_mutex);
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cinttypes>
+#include <pthread.h>
+#include <alsa/asoundlib.h>
+
+#include "PcmStreamSink.h"
+#include "SampleConversion.h"
+#include "Resampler.h"
+#include "Dynamics.h"
+
+//Mixes soundscape, speech and cue voices into one persistent stereo output stream.
+//The output device is opened once, voices never wait for each other.
+class AudioMixer
+{
+public:
+	enum class Voice
+	{
+		Soundscape = 0,
+		Speech,
+		Cue,
+		Count
+	};
+
+private:
+	struct VoiceState
+	{
+		std::deque<std::vector<float>> buffers; //interleaved stereo at the mixer rate
+		size_t position; //frames consumed from the front buffer
+		size_t pending_frames;
+		float gain;
+		size_t crossfade_frames; //overlap of consecutive buffers, 0: none
+		bool crossfading; //the next buffer is being faded in
+		bool starved; //ran out of buffers, see underruns
+	};
+
+	const int card_number;
+	int sample_freq_Hz; //negotiated with the device
+	std::string device_name;
+	bool verbose;
+
+	snd_pcm_t *pcm;
+	snd_pcm_uframes_t period_frames;
+	SampleFormat requested_format;
+	SampleFormat device_format; //negotiated, the device takes it without conversion
+	bool dither;
+	uint32_t dither_seed;
+	snd_mixer_t *mixer;
+	snd_mixer_elem_t *volume_elem; //nullptr: software gain
+	long volume_min;
+	long volume_max;
+	float master_gain;
+	float period_master_gain;
+	VoiceState voices[(int)Voice::Count];
+	float duck_gain;
+	float current_duck_gain;
+	std::unique_ptr<PeakLimiter> limiter;
+	std::unique_ptr<AutoGain> agc; //soundscape voice
+	float current_agc_gain;
+	bool quit;
+
+	std::vector<std::vector<float>> free_buffers;
+	std::map<int, std::shared_ptr<Resampler>> resamplers; //by input rate
+	std::atomic<double> resample_ms;
+	std::atomic<uint64_t> underruns;
+	std::atomic<uint64_t> overruns;
+	static const int maxQueuedSeconds = 3;
+	static const size_t maxFreeBuffers = 8;
+	std::vector<float> mixbuffer;
+	std::vector<uint8_t> outbuffer; //device format
+	std::vector<int16_t> streambuffer;
+	std::unique_ptr<PcmStreamSink> stream_sink;
+
+	pthread_mutex_t mixer_mutex;
+	pthread_mutex_t volume_mutex;
+	pthread_cond_t mixer_cond;
+	pthread_t mixer_thread;
+
+	AudioMixer(const AudioMixer& other) = delete;
+	AudioMixer& operator=(const AudioMixer&) = delete;
+
+	static void *runMixerThread(void *arg);
+	void mixerLoop();
+	void openDevice();
+	int openHwDevice(std::string device);
+	SampleFormat negotiateFormat(snd_pcm_hw_params_t *params);
+	void openVolumeControl();
+	void mixPeriod();
+	void writePeriod();
+	void recycleBuffer(std::vector<float> &buffer);
+	std::shared_ptr<Resampler> getResampler(int in_freq_Hz);
+	template<typename T>
+	void submit(Voice voice, const T *samples, int frame_count, int channels, int sample_freq_Hz, bool append);
+public:
+	//sample_freq_Hz: requested rate, the card's nearest native rate is used (see GetSampleFreq()).
+	//pcm_stream: also stream the output, see PcmStreamSink. Empty for none.
+	//format: preferred device format. If the card does not take it natively, the best native one is used.
+	//dither: TPDF dither when the output is reduced to 16 bits.
+	//dynamics: look-ahead limiter on the mix instead of clipping, and AGC of the soundscape voice.
+	AudioMixer(int card_number, int sample_freq_Hz, bool verbose = false, std::string pcm_stream = "",
+			   SampleFormat format = SampleFormat::S16, bool dither = false, const DynamicsParameters &dynamics = DynamicsParameters());
+	~AudioMixer();
+
+	//Queues interleaved samples, converted to stereo and the mixer rate (polyphase resampler). Returns immediately.
+	//Float samples are at full scale +-1.0.
+	void Submit(Voice voice, const int16_t *samples, int frame_count, int channels, int sample_freq_Hz);
+	void Submit(Voice voice, const float *samples, int frame_count, int channels, int sample_freq_Hz);
+	//Same, but adds the samples to the end of the voice's last queued buffer, so a soundscape can be queued in
+	//parts while it is rendered and is still crossfaded as a whole. Parts are resampled separately, so they should
+	//be at the mixer rate. Starts a new buffer if nothing is queued.
+	void Append(Voice voice, const float *samples, int frame_count, int channels, int sample_freq_Hz);
+	//Blocks until at most max_pending_frames of the voice are left to be mixed.
+	void WaitUntilPlayed(Voice voice, size_t max_pending_frames = 0);
+	//Drops queued samples of a voice, e.g. an outdated announcement.
+	void Flush(Voice voice);
+	bool IsActive(Voice voice);
+	//Part of the voice's current buffer that has been mixed (0.0-1.0), -1.0 if idle.
+	float GetPlayProgress(Voice voice);
+
+	void SetGain(Voice voice, float gain);
+	//Consecutive buffers of the voice overlap by frames (at the mixer rate), the next one is faded in.
+	//Only if it is queued before the overlap starts, otherwise it follows without fade.
+	void SetCrossfade(Voice voice, size_t frames);
+	//Soundscape gain while speech or cues are playing (1.0: no ducking).
+	void SetDucking(float duck_gain);
+	//Volume 0-100 %, set on the card's playback volume element or as software gain if there is none.
+	void SetVolume(int percent);
+	int GetSampleFreq() { return sample_freq_Hz; }
+	int GetPeriodFrames() { return period_frames; }
+	SampleFormat GetDeviceFormat() { return device_format; }
+	//Time of the last resampling in Submit(), 0 if none was needed.
+	double GetResampleTime_ms() { return resample_ms.load(); }
+	//Underruns: the device ran dry, or the soundscape stream had a gap. Overruns: waiting soundscapes
+	//dropped because more than maxQueuedSeconds were queued.
+	uint64_t GetUnderruns() { return underruns.load(); }
+	uint64_t GetOverruns() { return overruns.load(); }
+};
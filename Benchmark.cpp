@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <opencv/cv.h>
+
+#include "Benchmark.h"
+#include "ImageProcessing.h"
+#include "ImageToSoundscape.h"
+#include "Resampler.h"
+
+//Average ms per call, after one warm-up call:
+static double timeIt(std::function<void()> f, int iterations)
+{
+	f();
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < iterations; i++)
+	{
+		f();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) * 1.0e-6) / iterations;
+}
+
+static void printResult(std::string name, double ms)
+{
+	std::cout << "  " << std::left << std::setw(32) << name << std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms" << std::endl;
+}
+
+//Gradient with some rectangles and sensor-like noise:
+static cv::Mat makeTestImage(int rows, int columns)
+{
+	cv::Mat im(rows, columns, CV_8UC1);
+	srand(1);
+	for (int y = 0; y < rows; y++)
+	{
+		uchar *p = im.ptr<uchar>(y);
+		for (int x = 0; x < columns; x++)
+		{
+			int v = (x * 255) / columns;
+			if (((x / 16) % 3 == 1) && ((y / 8) % 2 == 1))
+			{
+				v = 255 - v;
+			}
+			v += (rand() % 17) - 8;
+			p[x] = (uchar)std::min(std::max(v, 0), 255);
+		}
+	}
+	return im;
+}
+
+static void benchmarkEdgeDetection(const RaspiVoiceOptions &opt, const cv::Mat &testImage)
+{
+	int iterations = 200;
+	float opacity = (opt.edge_detection_opacity > 0.0) ? opt.edge_detection_opacity : 0.5;
+	EdgeDetector edgeDetector;
+	cv::Mat dst;
+
+	std::cout << "Edge detection (" << testImage.cols << "x" << testImage.rows << ", threshold " << opt.edge_detection_threshold << ", opacity " << opacity << "):" << std::endl;
+
+	double canny_ms = timeIt([&]() { edgeDetector.Apply(testImage, dst, EdgeDetector::Mode::Canny, opt.edge_detection_threshold, opacity); }, iterations);
+	printResult("Canny", canny_ms);
+	double fast_ms = timeIt([&]() { edgeDetector.Apply(testImage, dst, EdgeDetector::Mode::Fast, opt.edge_detection_threshold, opacity); }, iterations);
+	printResult("Fast", fast_ms);
+	std::cout << "  Speedup: " << std::setprecision(1) << canny_ms / fast_ms << "x" << std::endl;
+}
+
+static SoundscapeParameters getSoundscapeParameters(const RaspiVoiceOptions &opt)
+{
+	SoundscapeParameters params;
+	params.rows = opt.rows;
+	params.columns = opt.columns;
+	params.freq_lowest = opt.freq_lowest;
+	params.freq_highest = opt.freq_highest;
+	params.sample_freq_Hz = opt.sample_freq_Hz;
+	params.total_time_s = opt.total_time_s;
+	params.use_exponential = opt.use_exponential;
+	params.use_stereo = opt.use_stereo;
+	params.use_delay = opt.use_delay;
+	params.use_fade = opt.use_fade;
+	params.use_diffraction = opt.use_diffraction;
+	params.use_bspline = opt.use_bspline;
+	params.speed_of_sound_m_s = opt.speed_of_sound_m_s;
+	params.acoustical_size_of_head_m = opt.acoustical_size_of_head_m;
+	params.engine = (SynthesisEngine)opt.synthesis_engine;
+	return params;
+}
+
+//Startup and every parameter change pay for this:
+static void benchmarkConverterConstruction(const RaspiVoiceOptions &opt)
+{
+	int iterations = 5;
+	SoundscapeParameters params = getSoundscapeParameters(opt);
+
+	std::cout << "Converter construction (" << params.rows << "x" << params.columns << ", " << params.sample_freq_Hz << " Hz, " << params.total_time_s << " s):" << std::endl;
+	printResult("Waveform cache", timeIt([&]() { ImageToSoundscapeConverter converter(params); }, iterations));
+}
+
+//One soundscape of the test image with each engine, and the memory it needs:
+static void benchmarkSynthesis(const RaspiVoiceOptions &opt, const cv::Mat &testImage)
+{
+	int iterations = 5;
+	uchar point_lut[256];
+	float amplitude_lut[256];
+	for (int v = 0; v < 256; v++)
+	{
+		point_lut[v] = v;
+	}
+	BuildAmplitudeLut(amplitude_lut);
+	std::vector<float> image(testImage.rows * testImage.cols);
+	MapToSoundscapeImage(testImage, point_lut, amplitude_lut, 0, 0, image, nullptr, nullptr);
+
+	SoundscapeParameters params = getSoundscapeParameters(opt);
+	std::cout << "Synthesis (" << params.rows << "x" << params.columns << ", " << params.sample_freq_Hz << " Hz, " << params.total_time_s << " s):" << std::endl;
+	const char *names[] = { "Time domain", "FFT overlap-add" };
+	for (int e = 0; e < 2; e++)
+	{
+		params.engine = (SynthesisEngine)e;
+		ImageToSoundscapeConverter converter(params);
+		std::vector<float> samples(converter.GetFrameCount() * converter.GetChannels());
+		printResult(names[e], timeIt([&]() { converter.Process(image.data(), samples.data()); }, iterations));
+		std::cout << "  " << std::left << std::setw(32) << "  memory" << std::right << std::setw(10) << converter.GetMemoryUsage() / 1024 << " kB" << std::endl;
+	}
+}
+
+//Speech and cues (espeak: 22050 Hz mono) to the output rate, per second of audio:
+static void benchmarkResampler(const RaspiVoiceOptions &opt)
+{
+	int iterations = 20;
+	int in_freq_Hz = 22050;
+	std::vector<float> in(in_freq_Hz);
+	for (int i = 0; i < in_freq_Hz; i++)
+	{
+		in[i] = 0.5f * sin(i * 0.1f);
+	}
+	Resampler resampler(in_freq_Hz, opt.sample_freq_Hz);
+	std::vector<float> out(resampler.GetOutputFrames(in.size()));
+
+	std::cout << "Resampler (" << in_freq_Hz << " -> " << opt.sample_freq_Hz << " Hz, mono):" << std::endl;
+	printResult("1 s of speech", timeIt([&]() { resampler.Process(in.data(), in.size(), 1, out.data(), 1); }, iterations));
+}
+
+void RunBenchmark(const RaspiVoiceOptions &opt)
+{
+	cv::Mat testImage = makeTestImage(opt.rows, opt.columns);
+
+	benchmarkEdgeDetection(opt, testImage);
+	benchmarkConverterConstruction(opt);
+	benchmarkSynthesis(opt, testImage);
+	benchmarkResampler(opt);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Options.h"
+
+//Times the processing stages at the size and settings given in opt and prints the results.
+void RunBenchmark(const RaspiVoiceOptions &opt);
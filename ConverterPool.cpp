@@ -0,0 +1,187 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "ConverterPool.h"
+#include "printtime.h"
+
+ConverterPool::ConverterPool(size_t memory_limit_bytes, size_t max_entries, bool verbose, bool lazy_cache) :
+	memory_limit(memory_limit_bytes),
+	max_entries(max_entries),
+	verbose(verbose),
+	lazy_cache(lazy_cache),
+	build_pending(false),
+	building(false),
+	quit(false)
+{
+	pthread_mutex_init(&pool_mutex, NULL);
+	pthread_cond_init(&pool_cond, NULL);
+
+	if (pthread_create(&builder_thread, NULL, runBuilderThread, this))
+	{
+		throw(std::runtime_error("Error setting up converter builder thread."));
+	}
+}
+
+ConverterPool::~ConverterPool()
+{
+	pthread_mutex_lock(&pool_mutex);
+	quit = true;
+	pthread_cond_broadcast(&pool_cond);
+	pthread_mutex_unlock(&pool_mutex);
+
+	pthread_join(builder_thread, nullptr);
+
+	pthread_cond_destroy(&pool_cond);
+	pthread_mutex_destroy(&pool_mutex);
+}
+
+void *ConverterPool::runBuilderThread(void *arg)
+{
+	static_cast<ConverterPool*>(arg)->builderLoop();
+	return nullptr;
+}
+
+void ConverterPool::builderLoop()
+{
+	pthread_mutex_lock(&pool_mutex);
+	while (!quit)
+	{
+		if (!build_pending)
+		{
+			pthread_cond_wait(&pool_cond, &pool_mutex);
+			continue;
+		}
+
+		//Only the latest request is built, intermediate presets are skipped:
+		building_params = pending_params;
+		build_pending = false;
+		building = true;
+		pthread_mutex_unlock(&pool_mutex);
+
+		if (verbose)
+		{
+			std::cout << "Building converter " << building_params.rows << "x" << building_params.columns << " in background" << std::endl;
+		}
+
+		std::shared_ptr<ImageToSoundscapeConverter> converter;
+		try
+		{
+			StageTimer timer;
+			converter = std::make_shared<ImageToSoundscapeConverter>(building_params, false, &tables);
+			if (verbose)
+			{
+				std::cout << "Converter built in " << timer.Lap() << " ms" << std::endl;
+			}
+		}
+		catch (std::exception &e)
+		{
+			std::cerr << "Error building converter: " << e.what() << std::endl;
+		}
+
+		pthread_mutex_lock(&pool_mutex);
+		if (converter)
+		{
+			addEntry(building_params, converter);
+		}
+		building = false;
+		pthread_cond_broadcast(&pool_cond);
+	}
+	pthread_mutex_unlock(&pool_mutex);
+}
+
+//pool_mutex must be locked.
+std::shared_ptr<ImageToSoundscapeConverter> ConverterPool::findEntry(const SoundscapeParameters &params)
+{
+	for (auto it = entries.begin(); it != entries.end(); it++)
+	{
+		if (it->params == params)
+		{
+			//Move to front (most recently used):
+			entries.splice(entries.begin(), entries, it);
+			return entries.front().converter;
+		}
+	}
+	return nullptr;
+}
+
+//pool_mutex must be locked.
+void ConverterPool::addEntry(const SoundscapeParameters &params, std::shared_ptr<ImageToSoundscapeConverter> converter)
+{
+	Entry entry;
+	entry.params = params;
+	entry.converter = converter;
+	entries.push_front(entry);
+
+	size_t total = 0;
+	for (auto it = entries.begin(); it != entries.end(); it++)
+	{
+		total += it->converter->GetMemoryUsage();
+	}
+
+	//Evict least recently used, always keep the newest one:
+	while ((entries.size() > 1) && ((total > memory_limit) || (entries.size() > max_entries)))
+	{
+		total -= entries.back().converter->GetMemoryUsage();
+		entries.pop_back();
+	}
+}
+
+std::shared_ptr<ImageToSoundscapeConverter> ConverterPool::Get(const SoundscapeParameters &params, bool wait)
+{
+	std::shared_ptr<ImageToSoundscapeConverter> converter;
+
+	pthread_mutex_lock(&pool_mutex);
+	converter = findEntry(params);
+	if (converter || (!wait && building && (building_params == params)))
+	{
+		pthread_mutex_unlock(&pool_mutex);
+		return converter;
+	}
+
+	if (!wait)
+	{
+		pending_params = params;
+		build_pending = true;
+		pthread_cond_broadcast(&pool_cond);
+		pthread_mutex_unlock(&pool_mutex);
+		return nullptr;
+	}
+
+	//Wait for a running build of the same parameters instead of building twice:
+	while (building && (building_params == params))
+	{
+		pthread_cond_wait(&pool_cond, &pool_mutex);
+	}
+	converter = findEntry(params);
+	pthread_mutex_unlock(&pool_mutex);
+
+	if (!converter)
+	{
+		StageTimer timer;
+		converter = std::make_shared<ImageToSoundscapeConverter>(params, lazy_cache, &tables);
+		if (verbose)
+		{
+			std::cout << "Converter " << params.rows << "x" << params.columns << " built in " << timer.Lap() << " ms" << std::endl;
+		}
+
+		pthread_mutex_lock(&pool_mutex);
+		addEntry(params, converter);
+		pthread_mutex_unlock(&pool_mutex);
+	}
+
+	return converter;
+}
+
+size_t ConverterPool::GetMemoryUsage()
+{
+	size_t total = 0;
+
+	pthread_mutex_lock(&pool_mutex);
+	for (auto it = entries.begin(); it != entries.end(); it++)
+	{
+		total += it->converter->GetMemoryUsage();
+	}
+	pthread_mutex_unlock(&pool_mutex);
+
+	return total;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <pthread.h>
+
+#include "ImageToSoundscape.h"
+
+//Keeps recently used converters ready for instant switching of synthesis parameters.
+//New converters are built on a background thread while the current one keeps playing.
+class ConverterPool
+{
+private:
+	struct Entry
+	{
+		SoundscapeParameters params;
+		std::shared_ptr<ImageToSoundscapeConverter> converter;
+	};
+
+	size_t memory_limit;
+	size_t max_entries;
+	bool verbose;
+	bool lazy_cache;
+	SynthesisTableRegistry tables; //converters with equal parameters share their table
+
+	std::list<Entry> entries; //most recently used first
+	bool build_pending;
+	SoundscapeParameters pending_params;
+	bool building;
+	SoundscapeParameters building_params;
+	bool quit;
+
+	pthread_mutex_t pool_mutex;
+	pthread_cond_t pool_cond;
+	pthread_t builder_thread;
+
+	ConverterPool(const ConverterPool& other) = delete;
+	ConverterPool& operator=(const ConverterPool&) = delete;
+
+	static void *runBuilderThread(void *arg);
+	void builderLoop();
+	std::shared_ptr<ImageToSoundscapeConverter> findEntry(const SoundscapeParameters &params);
+	void addEntry(const SoundscapeParameters &params, std::shared_ptr<ImageToSoundscapeConverter> converter);
+public:
+	//lazy_cache: converters built by Get() with wait == true return before their waveform cache is complete.
+	ConverterPool(size_t memory_limit_bytes, size_t max_entries = 4, bool verbose = false, bool lazy_cache = false);
+	~ConverterPool();
+
+	//Returns the converter for params. If it is not ready yet, wait == true builds it on the calling thread,
+	//otherwise a background build is scheduled and nullptr is returned.
+	std::shared_ptr<ImageToSoundscapeConverter> Get(const SoundscapeParameters &params, bool wait);
+	size_t GetMemoryUsage();
+};
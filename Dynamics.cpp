@@ -0,0 +1,125 @@
+#include <cmath>
+#include <algorithm>
+
+#include "Dynamics.h"
+
+PeakLimiter::PeakLimiter(int sample_freq_Hz, size_t max_frames, float ceiling_dB, float lookahead_ms, float release_ms) :
+	ceiling(pow(10.0, ceiling_dB / 20.0)),
+	release_coef(1.0 - exp(-1.0 / (std::max(release_ms, 1.0f) * 0.001 * sample_freq_Hz))),
+	window(std::max((size_t)lrint(lookahead_ms * 0.001 * sample_freq_Hz), (size_t)1)),
+	max_frames(max_frames),
+	gains(max_frames),
+	min_head(0),
+	min_count(0),
+	average_pos(0),
+	delay_pos(0),
+	frame_counter(0),
+	released_gain(1.0)
+{
+	min_values.resize(window);
+	min_frames.resize(window);
+	average_ring.assign(window, 1.0f);
+	average_sum = window;
+	delay_ring.assign(2 * (window - 1), 0.0f);
+}
+
+void PeakLimiter::Process(float *samples, size_t frames)
+{
+	frames = std::min(frames, max_frames);
+
+	//Gain each frame needs to stay below the ceiling, branch-free so it vectorizes:
+	for (size_t i = 0; i < frames; i++)
+	{
+		float peak = std::max(fabsf(samples[2 * i]), fabsf(samples[2 * i + 1]));
+		gains[i] = ceiling / std::max(peak, ceiling);
+	}
+
+	//The gain at the end of the window is the minimum over the window, released slowly and then averaged over
+	//the window again. Every gain averaged is at most the one the delayed frame needs, so the average is too:
+	for (size_t i = 0; i < frames; i++, frame_counter++)
+	{
+		if ((min_count > 0) && (min_frames[min_head] + window <= frame_counter))
+		{
+			min_head = (min_head + 1 == window) ? 0 : (min_head + 1);
+			min_count--;
+		}
+		float g = gains[i];
+		while ((min_count > 0) && (min_values[(min_head + min_count - 1) % window] >= g))
+		{
+			min_count--;
+		}
+		size_t back = (min_head + min_count) % window;
+		min_values[back] = g;
+		min_frames[back] = frame_counter;
+		min_count++;
+
+		float target = min_values[min_head];
+		released_gain = (target < released_gain) ? target : (released_gain + (target - released_gain) * release_coef);
+
+		average_sum += released_gain - average_ring[average_pos];
+		average_ring[average_pos] = released_gain;
+		average_pos = (average_pos + 1 == window) ? 0 : (average_pos + 1);
+
+		gains[i] = std::min((float)(average_sum / window), 1.0f);
+	}
+
+	//Delay the signal to the gain, in contiguous runs of the ring so the loops vectorize:
+	size_t delay_frames = window - 1;
+	if (delay_frames == 0)
+	{
+		for (size_t i = 0; i < frames; i++)
+		{
+			samples[2 * i] *= gains[i];
+			samples[2 * i + 1] *= gains[i];
+		}
+		return;
+	}
+
+	size_t i = 0;
+	while (i < frames)
+	{
+		size_t n = std::min(frames - i, delay_frames - delay_pos);
+		float *s = &samples[2 * i];
+		float *d = &delay_ring[2 * delay_pos];
+		const float *g = &gains[i];
+		for (size_t k = 0; k < n; k++)
+		{
+			float l = s[2 * k];
+			float r = s[2 * k + 1];
+			s[2 * k] = g[k] * d[2 * k];
+			s[2 * k + 1] = g[k] * d[2 * k + 1];
+			d[2 * k] = l;
+			d[2 * k + 1] = r;
+		}
+		i += n;
+		delay_pos += n;
+		if (delay_pos == delay_frames)
+		{
+			delay_pos = 0;
+		}
+	}
+}
+
+AutoGain::AutoGain(int sample_freq_Hz, float target_dB, float max_gain_dB, float time_s) :
+	target_mean_square(pow(10.0, target_dB / 10.0)),
+	max_gain(pow(10.0, fabs(max_gain_dB) / 20.0)),
+	min_gain(1.0 / max_gain),
+	time_s(std::max(time_s, 0.01f)),
+	sample_freq_Hz(sample_freq_Hz),
+	mean_square(target_mean_square),
+	gain(1.0)
+{
+}
+
+void AutoGain::Measure(double sum_of_squares, size_t frames, int channels)
+{
+	//Silence (below -60 dBFS) would pull the gain up to the maximum:
+	if ((frames == 0) || (channels <= 0) || (sum_of_squares < 1.0e-6 * frames * channels))
+	{
+		return;
+	}
+
+	double weight = 1.0 - exp(-(double)frames / (time_s * sample_freq_Hz));
+	mean_square += (sum_of_squares / (frames * channels) - mean_square) * weight;
+	gain = std::min(std::max((float)sqrt(target_mean_square / mean_square), min_gain), max_gain);
+}
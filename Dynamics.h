@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cinttypes>
+
+//Output stage dynamics, see AudioMixer.
+struct DynamicsParameters
+{
+	bool limiter = true;
+	float ceiling_dB = -1.0f; //dBFS
+	float lookahead_ms = 5.0f;
+	float release_ms = 100.0f;
+	bool agc = false;
+	float agc_target_dB = -20.0f; //RMS, dBFS
+	float agc_max_gain_dB = 12.0f; //also the maximum attenuation
+	float agc_time_s = 3.0f;
+};
+
+//Streaming look-ahead peak limiter for interleaved stereo. The gain is reduced over the look-ahead window
+//before a peak arrives, so no sample exceeds the ceiling and there is no clipping distortion.
+//The output is delayed by GetLatencyFrames(). No allocations after construction.
+class PeakLimiter
+{
+private:
+	float ceiling;
+	float release_coef;
+	size_t window; //look-ahead frames
+	size_t max_frames;
+
+	std::vector<float> gains; //per frame of the current block
+	//Minimum of the required gain over the window, a monotonic queue in a ring:
+	std::vector<float> min_values;
+	std::vector<uint64_t> min_frames;
+	size_t min_head;
+	size_t min_count;
+	//Moving average of the released gain over the window, so the gain is smooth and reaches its minimum with the peak:
+	std::vector<float> average_ring;
+	size_t average_pos;
+	double average_sum;
+	std::vector<float> delay_ring; //interleaved, window - 1 frames
+	size_t delay_pos;
+	uint64_t frame_counter;
+	float released_gain;
+
+	PeakLimiter(const PeakLimiter& other) = delete;
+	PeakLimiter& operator=(const PeakLimiter&) = delete;
+public:
+	//max_frames: largest block passed to Process().
+	PeakLimiter(int sample_freq_Hz, size_t max_frames, float ceiling_dB, float lookahead_ms, float release_ms);
+
+	//In place, frames <= max_frames.
+	void Process(float *samples, size_t frames);
+	size_t GetLatencyFrames() { return window - 1; }
+};
+
+//Slow automatic gain control: steers the RMS level of a signal towards a target over several seconds.
+//Silence is not measured, so the gain holds through pauses.
+class AutoGain
+{
+private:
+	float target_mean_square;
+	float max_gain;
+	float min_gain;
+	float time_s;
+	int sample_freq_Hz;
+	double mean_square;
+	float gain;
+public:
+	AutoGain(int sample_freq_Hz, float target_dB, float max_gain_dB, float time_s);
+
+	//Measures a block of interleaved frames (before this gain), given the sum of squares of all its samples,
+	//and updates the gain for the next block.
+	void Measure(double sum_of_squares, size_t frames, int channels);
+	float GetGain() { return gain; }
+};
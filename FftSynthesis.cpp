@@ -0,0 +1,284 @@
+#include <cmath>
+#include <algorithm>
+
+#include "FftSynthesis.h"
+
+#define TwoPi 6.283185307179586476925287
+
+FftSynthesizer::FftSynthesizer(const SynthesisTable &table, const SoundscapeParameters &params) :
+	params(params),
+	sampleCount(params.GetSampleCount()),
+	samplesPerColumn((uint32_t)(params.GetSampleCount() / params.columns)),
+	fftSize(GetFftSize(params)),
+	hop(GetFftSize(params) / 2)
+{
+	int rows = params.rows;
+	int half = fftSize / 2;
+	float sweep_time_s = sampleCount / (float)params.sample_freq_Hz;
+
+	periods.resize(rows);
+	phase0.resize(rows);
+	freq.resize(rows);
+	diffraction.resize(rows);
+	lobeBin.resize(rows * lobeBins);
+	lobeWeightRe.resize(rows * lobeBins);
+	lobeWeightIm.resize(rows * lobeBins);
+	for (int i = 0; i < rows; i++)
+	{
+		//Same oscillators as the waveform cache:
+		float omega = table.GetOmega(i);
+		uint32_t k = (uint32_t)lrintf(omega * sweep_time_s / (float)TwoPi);
+		periods[i] = k % sampleCount;
+		phase0[i] = table.GetPhi0(i) / (float)TwoPi;
+		freq[i] = omega / (float)TwoPi;
+		diffraction[i] = TwoPi * params.speed_of_sound_m_s / omega;
+
+		//A sine at fractional bin nu, centered in the frame, has the window's transform around nu with
+		//alternating signs. Bins below 0 and above the Nyquist frequency fold back conjugated:
+		double nu = (double)k * fftSize / sampleCount;
+		int center_bin = (int)lrint(nu);
+		for (int t = 0; t < lobeBins; t++)
+		{
+			int bin = center_bin - lobeHalfWidth + t;
+			double w = hannLobe(bin - nu, fftSize) / fftSize * ((bin & 1) ? -1.0 : 1.0);
+			float re = w;
+			float im = w;
+			if ((bin == 0) || (bin == half))
+			{
+				re = 2.0 * w;
+				im = 0.0;
+			}
+			else if ((bin < 0) || (bin > half))
+			{
+				im = -w;
+			}
+			lobeBin[i * lobeBins + t] = (bin < 0) ? -bin : ((bin > half) ? (fftSize - bin) : bin);
+			lobeWeightRe[i * lobeBins + t] = re;
+			lobeWeightIm[i * lobeBins + t] = im;
+		}
+	}
+
+	leftRe.resize(half + 1);
+	leftIm.resize(half + 1);
+	rightRe.resize(half + 1);
+	rightIm.resize(half + 1);
+	frameRe.resize(fftSize);
+	frameIm.resize(fftSize);
+
+	twiddleRe.resize(half);
+	twiddleIm.resize(half);
+	for (int k = 0; k < half; k++)
+	{
+		twiddleRe[k] = cos(TwoPi * k / fftSize);
+		twiddleIm[k] = sin(TwoPi * k / fftSize);
+	}
+	bitReverse.resize(fftSize);
+	int bits = 0;
+	while ((1 << bits) < fftSize)
+	{
+		bits++;
+	}
+	for (int n = 0; n < fftSize; n++)
+	{
+		int reversed = 0;
+		for (int b = 0; b < bits; b++)
+		{
+			reversed |= ((n >> b) & 1) << (bits - 1 - b);
+		}
+		bitReverse[n] = reversed;
+	}
+}
+
+int FftSynthesizer::GetFftSize(const SoundscapeParameters &params)
+{
+	//At least two frames per column, the envelope is sampled at the frame centers:
+	uint32_t samples_per_column = params.GetSampleCount() / params.columns;
+	int size = 32;
+	while ((uint32_t)size <= samples_per_column / 2)
+	{
+		size *= 2;
+	}
+	return size;
+}
+
+size_t FftSynthesizer::GetMemoryUsage(const SoundscapeParameters &params)
+{
+	//Per row tables and lobes, spectra, frame and FFT tables:
+	size_t size = GetFftSize(params);
+	return (size_t)params.rows * (4 * sizeof(float) + lobeBins * (sizeof(int) + 2 * sizeof(float))) +
+		size * (5 * sizeof(float) + sizeof(int));
+}
+
+//Transform of the periodic Hann window of size samples, centered on sample size / 2, at bins from its center.
+//The window is three cosines, so this is the sum of three shifted Dirichlet kernels. Real, as the window is even.
+double FftSynthesizer::hannLobe(double bins, int size)
+{
+	const double weights[3] = { 0.25, 0.5, 0.25 };
+	double sum = 0.0;
+	for (int s = -1; s <= 1; s++)
+	{
+		double d = bins + s;
+		double dirichlet = (fabs(d) < 1.0e-9) ? size : (cos(0.5 * TwoPi * d / size) * sin(0.5 * TwoPi * d) / sin(0.5 * TwoPi * d / size));
+		sum += weights[s + 1] * dirichlet;
+	}
+	return sum;
+}
+
+void FftSynthesizer::Render(const float *image, uint32_t first_sample, uint32_t end_sample, float *samples)
+{
+	if (first_sample >= end_sample)
+	{
+		return;
+	}
+	std::fill(samples, samples + 2 * (end_sample - first_sample), 0.0f);
+
+	//Frame n covers samples [(n - 1) * hop, (n + 1) * hop), so every sample is in two frames, whose windows add up to 1:
+	uint32_t first_frame = first_sample / hop;
+	uint32_t last_frame = (end_sample - 1) / hop + 1;
+	for (uint32_t frame = first_frame; frame <= last_frame; frame++)
+	{
+		synthesizeFrame(image, frame);
+
+		int64_t frame_start = (int64_t)frame * hop - hop;
+		uint32_t from = (uint32_t)std::max(frame_start, (int64_t)first_sample);
+		uint32_t to = (uint32_t)std::min(frame_start + fftSize, (int64_t)end_sample);
+		const float *left = &frameRe[from - frame_start];
+		const float *right = &frameIm[from - frame_start];
+		float *dst = &samples[2 * (from - first_sample)];
+		for (uint32_t n = 0; n < to - from; n++)
+		{
+			dst[2 * n] += left[n];
+			dst[2 * n + 1] += right[n];
+		}
+	}
+}
+
+void FftSynthesizer::synthesizeFrame(const float *image, uint32_t frame)
+{
+	int rows = params.rows;
+	int columns = params.columns;
+	int half = fftSize / 2;
+	std::fill(leftRe.begin(), leftRe.end(), 0.0f);
+	std::fill(leftIm.begin(), leftIm.end(), 0.0f);
+	std::fill(rightRe.begin(), rightRe.end(), 0.0f);
+	std::fill(rightIm.begin(), rightIm.end(), 0.0f);
+
+	//Envelope and binaural model at the frame center, as in the time domain engine:
+	uint32_t center = frame * hop;
+	uint32_t sample = std::min(center, sampleCount - 1);
+	int j = std::min(sample / samplesPerColumn, (uint32_t)columns - 1);
+	float w1 = 0.0, w2 = 1.0, w3 = 0.0;
+	if (params.use_bspline)
+	{
+		float q = 1.0 * (sample % samplesPerColumn) / (samplesPerColumn - 1);
+		float q2 = 0.5 * q * q;
+		if (j == 0)
+		{
+			w2 = 1.0 - q2;
+			w3 = q2;
+		}
+		else
+		{
+			w1 = q2 - q + 0.5;
+			w2 = 0.5 + q - q*q;
+			w3 = (j == columns - 1) ? 0.0 : q2;
+		}
+	}
+	const float *im2 = &image[j * rows];
+	const float *im1 = (j > 0) ? (im2 - rows) : im2;
+	const float *im3 = (j < columns - 1) ? (im2 + rows) : im2;
+
+	float r = 1.0 * sample / (sampleCount - 1);
+	float theta = (r - 0.5) * TwoPi / 3;
+	float x = 0.5 * params.acoustical_size_of_head_m * (theta + sin(theta));
+	float delay_s = params.use_delay ? (x / params.speed_of_sound_m_s) : 0.0f;
+	x = fabs(x);
+	float fadel = params.use_fade ? (1.0 - 0.7*r) : 1.0;
+	float fader = params.use_fade ? (0.3 + 0.7*r) : 1.0;
+
+	uint64_t phase_step = center % sampleCount;
+	for (int i = 0; i < rows; i++)
+	{
+		float a = w1 * im1[i] + w2 * im2[i] + w3 * im3[i];
+		if (a == 0.0f)
+		{
+			continue;
+		}
+
+		float hrtf = 1.0;
+		if (params.use_diffraction && (diffraction[i] <= x))
+		{
+			hrtf = diffraction[i] / x;
+		}
+		float al = 0.5f * a * ((theta < 0.0) ? fadel : (hrtf * fadel));
+		float ar = 0.5f * a * ((theta < 0.0) ? (hrtf * fader) : fader);
+
+		//sin(p) is the real part of exp(jp) * -j:
+		float u = (float)((periods[i] * phase_step) % sampleCount) / sampleCount + phase0[i];
+		float pl = (float)TwoPi * u;
+		float pr = (float)TwoPi * (u + freq[i] * delay_s);
+		float lr = al * sinf(pl), li = -al * cosf(pl);
+		float rr = ar * sinf(pr), ri = -ar * cosf(pr);
+
+		const int *bin = &lobeBin[i * lobeBins];
+		const float *wr = &lobeWeightRe[i * lobeBins];
+		const float *wi = &lobeWeightIm[i * lobeBins];
+		for (int t = 0; t < lobeBins; t++)
+		{
+			int b = bin[t];
+			leftRe[b] += wr[t] * lr;
+			leftIm[b] += wi[t] * li;
+			rightRe[b] += wr[t] * rr;
+			rightIm[b] += wi[t] * ri;
+		}
+	}
+
+	//Both channels are real, so they go into one transform as left + j right:
+	for (int k = 0; k <= half; k++)
+	{
+		frameRe[k] = leftRe[k] - rightIm[k];
+		frameIm[k] = leftIm[k] + rightRe[k];
+	}
+	for (int k = 1; k < half; k++)
+	{
+		frameRe[fftSize - k] = leftRe[k] + rightIm[k];
+		frameIm[fftSize - k] = rightRe[k] - leftIm[k];
+	}
+	inverseFft();
+}
+
+//In place radix-2, unscaled, as 1/fftSize is in the lobe weights.
+void FftSynthesizer::inverseFft()
+{
+	for (int n = 0; n < fftSize; n++)
+	{
+		int m = bitReverse[n];
+		if (m > n)
+		{
+			std::swap(frameRe[n], frameRe[m]);
+			std::swap(frameIm[n], frameIm[m]);
+		}
+	}
+
+	for (int size = 2; size <= fftSize; size *= 2)
+	{
+		int half = size / 2;
+		int step = fftSize / size;
+		for (int start = 0; start < fftSize; start += size)
+		{
+			float *re = &frameRe[start];
+			float *im = &frameIm[start];
+			for (int k = 0; k < half; k++)
+			{
+				float wr = twiddleRe[k * step];
+				float wi = twiddleIm[k * step];
+				float tr = re[k + half] * wr - im[k + half] * wi;
+				float ti = re[k + half] * wi + im[k + half] * wr;
+				re[k + half] = re[k] - tr;
+				im[k + half] = im[k] - ti;
+				re[k] += tr;
+				im[k] += ti;
+			}
+		}
+	}
+}
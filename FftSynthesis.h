@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cinttypes>
+
+#include "SynthesisTable.h"
+
+//Soundscape synthesis by inverse FFT overlap-add, for many rows: every frame of fftSize samples, hopped by
+//half of it, is built as a spectrum and transformed at once. Each row adds the spectrum of a Hann windowed
+//sine at its exact frequency (the window's main lobe and first side lobes around the row's bin), with the
+//amplitude, phase and binaural gains at the frame center, so the envelope is sampled at least twice per column.
+//The phase is that of the time domain oscillator, so rows continue from frame to frame and sweep to sweep,
+//and the right channel's delay is a phase shift. Both channels are packed into one complex transform.
+//Cost per frame: rows x lobe bins + fftSize log fftSize. Not thread-safe, one per converter.
+class FftSynthesizer
+{
+private:
+	const SoundscapeParameters params;
+	const uint32_t sampleCount;
+	const uint32_t samplesPerColumn;
+	int fftSize; //largest power of two with half of it in half a column
+	int hop;
+
+	static const int lobeHalfWidth = 6; //bins on each side of the row's bin, the side lobes left out are below -55 dB
+	static const int lobeBins = 2 * lobeHalfWidth + 1;
+
+	std::vector<uint32_t> periods; //whole periods of each row per sweep
+	std::vector<float> phase0; //cycles
+	std::vector<float> freq;
+	std::vector<float> diffraction;
+	//Per row and lobe bin: target bin of the one-sided spectrum, and weights with the window, 1/fftSize and the
+	//folding of bins beyond 0 and the Nyquist frequency:
+	std::vector<int> lobeBin;
+	std::vector<float> lobeWeightRe;
+	std::vector<float> lobeWeightIm;
+
+	std::vector<float> leftRe, leftIm, rightRe, rightIm; //one-sided spectra
+	std::vector<float> frameRe, frameIm; //packed spectrum, then left and right frame
+	std::vector<float> twiddleRe, twiddleIm;
+	std::vector<int> bitReverse;
+
+	FftSynthesizer(const FftSynthesizer& other) = delete;
+	FftSynthesizer& operator=(const FftSynthesizer&) = delete;
+
+	static double hannLobe(double bins, int size);
+	void synthesizeFrame(const float *image, uint32_t frame);
+	void inverseFft();
+public:
+	FftSynthesizer(const SynthesisTable &table, const SoundscapeParameters &params);
+
+	//Row sums of image for samples [first_sample, end_sample) of the sweep as interleaved stereo, before
+	//the output filter. Frames are on a fixed grid, so ranges rendered one after another join seamlessly.
+	void Render(const float *image, uint32_t first_sample, uint32_t end_sample, float *samples);
+	int GetFftSize() const { return fftSize; }
+	size_t GetMemoryUsage() const { return GetMemoryUsage(params); }
+	static size_t GetMemoryUsage(const SoundscapeParameters &params);
+	static int GetFftSize(const SoundscapeParameters &params);
+};
@@ -0,0 +1,363 @@
+#include <vector>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "ImageProcessing.h"
+
+void AreaDownscale(const cv::Mat &src, cv::Mat &dst, int first_column, int last_column)
+{
+	int step = src.channels();
+	int sw = src.cols;
+	int sh = src.rows;
+	int dw = dst.cols;
+	int dh = dst.rows;
+	if ((last_column < 0) || (last_column > dw))
+	{
+		last_column = dw;
+	}
+	if (first_column >= last_column)
+	{
+		return;
+	}
+
+	//Source column range of every target column, at least one pixel when upscaling:
+	std::vector<int> x0(dw + 1);
+	for (int x = 0; x <= dw; x++)
+	{
+		x0[x] = (int)((int64_t)x * sw / dw);
+	}
+	int src_first = std::min(x0[first_column], sw - 1);
+	int src_last = std::min(std::max(x0[last_column], std::min(x0[last_column - 1], sw - 1) + 1), sw);
+
+	std::vector<uint32_t> column_sums(sw);
+
+	for (int y = 0; y < dh; y++)
+	{
+		int y0 = (int)((int64_t)y * sh / dh);
+		int y1 = std::max((int)((int64_t)(y + 1) * sh / dh), y0 + 1);
+
+		//Sum the source rows of this target row per source column:
+		std::fill(column_sums.begin() + src_first, column_sums.begin() + src_last, 0);
+		for (int sy = y0; sy < y1; sy++)
+		{
+			const uchar *p = src.ptr<uchar>(sy) + src_first * step;
+			for (int sx = src_first; sx < src_last; sx++, p += step)
+			{
+				column_sums[sx] += *p;
+			}
+		}
+
+		uchar *q = dst.ptr<uchar>(y);
+		for (int x = first_column; x < last_column; x++)
+		{
+			int sx0 = std::min(x0[x], sw - 1);
+			int sx1 = std::max(x0[x + 1], sx0 + 1);
+			uint32_t sum = 0;
+			for (int sx = sx0; sx < sx1; sx++)
+			{
+				sum += column_sums[sx];
+			}
+			uint32_t count = (sx1 - sx0) * (y1 - y0);
+			q[x] = (uchar)((sum + count / 2) / count);
+		}
+	}
+}
+
+void BuildPointLut(float contrast, float brightness, int threshold, bool negative, const double *histogram, uchar lut[256])
+{
+	for (int v = 0; v < 256; v++)
+	{
+		lut[v] = cv::saturate_cast<uchar>(contrast * v + brightness);
+	}
+
+	if (threshold > 0)
+	{
+		if (threshold >= 255)
+		{
+			//Otsu on the histogram after contrast/brightness:
+			double mapped[256] = { 0 };
+			for (int v = 0; v < 256; v++)
+			{
+				mapped[lut[v]] += histogram[v];
+			}
+			threshold = OtsuThreshold(mapped);
+		}
+
+		for (int v = 0; v < 256; v++)
+		{
+			lut[v] = (lut[v] > threshold) ? 255 : 0;
+		}
+	}
+
+	if (negative)
+	{
+		for (int v = 0; v < 256; v++)
+		{
+			lut[v] = 255 - lut[v];
+		}
+	}
+}
+
+int OtsuThreshold(const double histogram[256])
+{
+	double total = 0;
+	double sum = 0;
+	for (int v = 0; v < 256; v++)
+	{
+		total += histogram[v];
+		sum += v * histogram[v];
+	}
+
+	double weight_low = 0;
+	double sum_low = 0;
+	double best_variance = -1;
+	int best_threshold = 0;
+	for (int t = 0; t < 256; t++)
+	{
+		weight_low += histogram[t];
+		sum_low += t * histogram[t];
+		double weight_high = total - weight_low;
+		if ((weight_low == 0) || (weight_high == 0))
+		{
+			continue;
+		}
+
+		double mean_low = sum_low / weight_low;
+		double mean_high = (sum - sum_low) / weight_high;
+		double variance = weight_low * weight_high * (mean_low - mean_high) * (mean_low - mean_high);
+		if (variance > best_variance)
+		{
+			best_variance = variance;
+			best_threshold = t;
+		}
+	}
+
+	return best_threshold;
+}
+
+void ComputeHistogram(const cv::Mat &src, int first_column, int last_column, uint32_t histogram[256])
+{
+	std::fill(histogram, histogram + 256, 0);
+	for (int y = 0; y < src.rows; y++)
+	{
+		const uchar *p = src.ptr<uchar>(y);
+		for (int x = first_column; x < last_column; x++)
+		{
+			histogram[p[x]]++;
+		}
+	}
+}
+
+SmoothedHistogram::SmoothedHistogram()
+{
+	Reset();
+}
+
+void SmoothedHistogram::Reset()
+{
+	std::fill(bins, bins + 256, 0.0);
+	valid = false;
+}
+
+void SmoothedHistogram::Update(const uint32_t histogram[256], double weight)
+{
+	double total = 0;
+	for (int v = 0; v < 256; v++)
+	{
+		total += histogram[v];
+	}
+	if (total == 0)
+	{
+		return;
+	}
+
+	if (!valid)
+	{
+		weight = 1.0;
+	}
+	for (int v = 0; v < 256; v++)
+	{
+		bins[v] += (histogram[v] / total - bins[v]) * weight;
+	}
+	valid = true;
+}
+
+int SmoothedHistogram::Percentile(double p)
+{
+	double sum = 0;
+	for (int v = 0; v < 256; v++)
+	{
+		sum += bins[v];
+		if (sum >= p)
+		{
+			return v;
+		}
+	}
+	return 255;
+}
+
+void BuildAmplitudeLut(float lut[256])
+{
+	for (int v = 0; v < 256; v++)
+	{
+		int mVal = v / 16;
+		if (mVal == 0)
+		{
+			lut[v] = 0;
+		}
+		else
+		{
+			lut[v] = pow(10.0, (mVal - 15) / 10.0);   // 2dB steps
+		}
+	}
+}
+
+void MapToSoundscapeImage(const cv::Mat &src, const uchar point_lut[256], const float amplitude_lut[256],
+						  int flip, int blinders, std::vector<float> &image, cv::Mat *preview, uint32_t *histogram)
+{
+	int rows = src.rows;
+	int columns = src.cols;
+	bool flip_h = (flip == 1) || (flip == 3);
+	bool flip_v = (flip == 2) || (flip == 3);
+	if ((blinders <= 0) || (blinders >= columns / 2))
+	{
+		blinders = 0;
+	}
+
+	float lut[256];
+	for (int v = 0; v < 256; v++)
+	{
+		lut[v] = amplitude_lut[point_lut[v]];
+	}
+
+	if (preview != nullptr)
+	{
+		preview->create(rows, columns, CV_8UC1);
+	}
+	if (histogram != nullptr)
+	{
+		std::fill(histogram, histogram + 256, 0);
+	}
+
+	//Image rows are stored bottom up, a vertical flip cancels that:
+	for (int j = 0; j < columns; j++)
+	{
+		int sx = flip_h ? (columns - 1 - j) : j;
+		bool blinded = (sx < blinders) || (sx >= columns - blinders);
+		float *dst = &image[j * rows];
+
+		for (int i = 0; i < rows; i++)
+		{
+			int sy = flip_v ? i : (rows - 1 - i);
+			uchar v = blinded ? 0 : src.ptr<uchar>(sy)[sx];
+			dst[i] = lut[v];
+			if ((histogram != nullptr) && !blinded)
+			{
+				histogram[v]++;
+			}
+			if (preview != nullptr)
+			{
+				preview->ptr<uchar>(rows - 1 - i)[j] = point_lut[v];
+			}
+		}
+	}
+}
+
+void EdgeDetector::Apply(const cv::Mat &src, cv::Mat &dst, Mode mode, int threshold, float opacity)
+{
+	if (threshold <= 0)
+	{
+		threshold = 127;
+	}
+	if (opacity > 1.0)
+	{
+		opacity = 1.0;
+	}
+
+	if (mode == Mode::Fast)
+	{
+		fastEdgeBlend(src, dst, threshold, opacity);
+	}
+	else
+	{
+		cannyEdgeBlend(src, dst, threshold, opacity);
+	}
+}
+
+void EdgeDetector::cannyEdgeBlend(const cv::Mat &src, cv::Mat &dst, int threshold, float opacity)
+{
+	int ratio = 3;
+	int kernel_size = 3;
+	cv::blur(src, blurImage, cv::Size(3, 3));
+	cv::Canny(blurImage, edgesImage, threshold, threshold*ratio, kernel_size);
+
+	double alpha = opacity;
+	double beta = (1.0 - alpha);
+	cv::addWeighted(edgesImage, alpha, src, beta, 0.0, dst);
+}
+
+void EdgeDetector::fastEdgeBlend(const cv::Mat &src, cv::Mat &dst, int threshold, float opacity)
+{
+	int rows = src.rows;
+	int columns = src.cols;
+	dst.create(rows, columns, CV_8UC1);
+
+	//Between the Canny hysteresis thresholds, on the same L1 Sobel magnitude scale:
+	int edge_threshold = 2 * threshold;
+	//dst = (src * (256 - a) + edge * 255 * a + 128) / 256, fits in 16 bits:
+	int a = std::min(std::max((int)(opacity * 256.0f + 0.5f), 1), 256);
+	int src_weight = 256 - a;
+	int edge_value = 255 * a;
+
+	for (int y = 0; y < rows; y++)
+	{
+		//Border rows and columns are replicated:
+		const uchar *r0 = src.ptr<uchar>(std::max(y - 1, 0));
+		const uchar *r1 = src.ptr<uchar>(y);
+		const uchar *r2 = src.ptr<uchar>(std::min(y + 1, rows - 1));
+		uchar *q = dst.ptr<uchar>(y);
+
+		int x = 0;
+		while (x < columns)
+		{
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+			if ((x >= 1) && (x + 8 < columns))
+			{
+				int16x8_t t_l = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r0 + x - 1)));
+				int16x8_t t_c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r0 + x)));
+				int16x8_t t_r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r0 + x + 1)));
+				int16x8_t m_l = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r1 + x - 1)));
+				uint8x8_t m_c8 = vld1_u8(r1 + x);
+				int16x8_t m_r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r1 + x + 1)));
+				int16x8_t b_l = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r2 + x - 1)));
+				int16x8_t b_c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r2 + x)));
+				int16x8_t b_r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(r2 + x + 1)));
+
+				int16x8_t gx = vaddq_s16(vsubq_s16(t_r, t_l), vsubq_s16(b_r, b_l));
+				gx = vaddq_s16(gx, vshlq_n_s16(vsubq_s16(m_r, m_l), 1));
+				int16x8_t gy = vaddq_s16(vsubq_s16(b_l, t_l), vsubq_s16(b_r, t_r));
+				gy = vaddq_s16(gy, vshlq_n_s16(vsubq_s16(b_c, t_c), 1));
+				int16x8_t magnitude = vaddq_s16(vabsq_s16(gx), vabsq_s16(gy));
+
+				uint16x8_t edge = vandq_u16(vcgtq_s16(magnitude, vdupq_n_s16(edge_threshold)), vdupq_n_u16(edge_value));
+				uint16x8_t sum = vmlal_u8(edge, m_c8, vdup_n_u8(src_weight));
+				vst1_u8(q + x, vrshrn_n_u16(sum, 8));
+				x += 8;
+				continue;
+			}
+#endif
+			int xl = std::max(x - 1, 0);
+			int xr = std::min(x + 1, columns - 1);
+			int gx = (r0[xr] - r0[xl]) + 2 * (r1[xr] - r1[xl]) + (r2[xr] - r2[xl]);
+			int gy = (r2[xl] + 2 * r2[x] + r2[xr]) - (r0[xl] + 2 * r0[x] + r0[xr]);
+			int magnitude = std::abs(gx) + std::abs(gy);
+			int edge = (magnitude > edge_threshold) ? edge_value : 0;
+			q[x] = (uchar)((r1[x] * src_weight + edge + 128) >> 8);
+			x++;
+		}
+	}
+}
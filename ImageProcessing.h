@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <cinttypes>
+#include <opencv/cv.h>
+
+//Downscales the 8-bit image src to the size of dst (CV_8UC1) in one pass, averaging the source area
+//of each target pixel. Two-channel sources (YUYV) are read from channel 0.
+//Target columns outside [first_column, last_column) are left untouched.
+void AreaDownscale(const cv::Mat &src, cv::Mat &dst, int first_column = 0, int last_column = -1);
+
+//Compiles contrast/brightness, threshold and negative into one lookup table, applied in that order.
+//threshold: 0 off, 1-254 fixed, >= 255 auto (Otsu on histogram, which must be given in that case).
+void BuildPointLut(float contrast, float brightness, int threshold, bool negative, const double *histogram, uchar lut[256]);
+
+//Otsu threshold of a 256-bin histogram.
+int OtsuThreshold(const double histogram[256]);
+
+//Histogram of the target columns [first_column, last_column) of an 8-bit image.
+void ComputeHistogram(const cv::Mat &src, int first_column, int last_column, uint32_t histogram[256]);
+
+//Normalized histogram averaged over frames, so automatic settings do not jump with noise.
+class SmoothedHistogram
+{
+private:
+	double bins[256];
+	bool valid;
+public:
+	SmoothedHistogram();
+	void Reset();
+	//Blends in a new histogram with the given weight (1.0: no smoothing).
+	void Update(const uint32_t histogram[256], double weight);
+	bool IsValid() { return valid; }
+	const double *Data() { return bins; }
+	//Lowest value with at least the fraction p of pixels at or below it.
+	int Percentile(double p);
+};
+
+//Amplitudes of the soundscape for 8-bit pixel values: 16 levels in 2 dB steps, 0 for black.
+void BuildAmplitudeLut(float lut[256]);
+
+//Single pass from the target-size 8-bit image to the converter's column-major float image (row 0 at the bottom).
+//Point operations come from point_lut, flip (1: h, 2: v, 3: both) and blinders are applied through the index mapping.
+//Blinded pixels are treated as black before point_lut. If preview is not null, the processed 8-bit image is stored there.
+//If histogram is not null, it receives the histogram of the unblinded src pixels.
+void MapToSoundscapeImage(const cv::Mat &src, const uchar point_lut[256], const float amplitude_lut[256],
+						  int flip, int blinders, std::vector<float> &image, cv::Mat *preview = nullptr, uint32_t *histogram = nullptr);
+
+//Edge detection blended over the image, with the work buffers kept between frames.
+//Canny: blur, cv::Canny and addWeighted. Fast: integer 3x3 Sobel magnitude |gx|+|gy| against
+//a fixed threshold, blended in the same pass (NEON on ARM).
+class EdgeDetector
+{
+public:
+	enum class Mode
+	{
+		Canny = 0,
+		Fast
+	};
+
+private:
+	cv::Mat blurImage;
+	cv::Mat edgesImage;
+
+	void cannyEdgeBlend(const cv::Mat &src, cv::Mat &dst, int threshold, float opacity);
+	void fastEdgeBlend(const cv::Mat &src, cv::Mat &dst, int threshold, float opacity);
+public:
+	//src and dst (CV_8UC1) must not be the same image. threshold: 1-255, opacity: 0.0-1.0.
+	void Apply(const cv::Mat &src, cv::Mat &dst, Mode mode, int threshold, float opacity);
+};
@@ -12,8 +12,10 @@
 #include <cinttypes>
 #include <cmath>
 #include <stdexcept>
+#include <algorithm>
 
 #include "ImageToSoundscape.h"
+#include "SampleConversion.h"
 
 #define TwoPi 6.283185307179586476925287
 
@@ -21,7 +23,8 @@ ImageToSoundscapeConverter::ImageToSoundscapeConverter(int rows, int columns, do
 													   int sample_freq_Hz, double total_time_s, bool use_exponential,
 													   bool use_stereo, bool use_delay, bool use_fade,
 													   bool use_diffraction, bool use_bspline, float speed_of_sound_m_s,
-													   float acoustical_size_of_head_m) :
+													   float acoustical_size_of_head_m, SynthesisEngine engine, bool lazy_cache,
+													   SynthesisTableRegistry *registry) :
 	rows(rows),
 	columns(columns), freq_lowest(freq_lowest),
 	freq_highest(freq_highest),
@@ -35,51 +38,75 @@ ImageToSoundscapeConverter::ImageToSoundscapeConverter(int rows, int columns, do
 	use_bspline(use_bspline),
 	speed_of_sound_m_s(speed_of_sound_m_s),
 	acoustical_size_of_head_m(acoustical_size_of_head_m),
+	engine(engine),
 
-	sampleCount(2L * (uint32_t)(0.5 * sample_freq_Hz * total_time_s)),
+	sampleCount(GetParameters().GetSampleCount()),
 	samplesPerColumn((uint32_t)(sampleCount / columns)),
 	timePerSample_s(1.0 / sample_freq_Hz),
 	scale(0.5 / sqrt((float)rows)),
-	audioData(0, sample_freq_Hz, sampleCount, use_stereo),
-	omega(std::vector<float>(rows)),
-	phi0(std::vector<float>(rows)),
-	waveformCacheLeftChannel(std::vector<float>(sampleCount*rows)),
-	waveformCacheRightChannel(std::vector<float>(sampleCount*rows))
+	randomSeed(0)
 {
-	// Set lin|exp (0|1) frequency distribution and random initial phase
-	if (use_exponential)
+	table = registry ? registry->Get(GetParameters(), lazy_cache) : SynthesisTable::Create(GetParameters(), lazy_cache);
+	if (engine == SynthesisEngine::Fft)
 	{
-		for (int i = 0; i < rows; i++)
-		{
-			omega[i] = TwoPi * freq_lowest * pow(1.0 * freq_highest / freq_lowest, 1.0 * i / (rows - 1));
-		}
-	}
-	else
-	{
-		for (int i = 0; i < rows; i++)
-		{
-			omega[i] = TwoPi * freq_lowest + TwoPi * (freq_highest - freq_lowest) * i / (rows - 1);
-		}
+		fft.reset(new FftSynthesizer(*table, GetParameters()));
 	}
+}
 
-	for (int i = 0; i<rows; i++)
+ImageToSoundscapeConverter::ImageToSoundscapeConverter(const SoundscapeParameters &params, bool lazy_cache, SynthesisTableRegistry *registry) :
+	ImageToSoundscapeConverter(params.rows, params.columns, params.freq_lowest, params.freq_highest,
+							   params.sample_freq_Hz, params.total_time_s, params.use_exponential,
+							   params.use_stereo, params.use_delay, params.use_fade,
+							   params.use_diffraction, params.use_bspline, params.speed_of_sound_m_s,
+							   params.acoustical_size_of_head_m, params.engine, lazy_cache, registry)
+{
+}
+
+SoundscapeParameters ImageToSoundscapeConverter::GetParameters() const
+{
+	SoundscapeParameters params;
+	params.rows = rows;
+	params.columns = columns;
+	params.freq_lowest = freq_lowest;
+	params.freq_highest = freq_highest;
+	params.sample_freq_Hz = sample_freq_Hz;
+	params.total_time_s = total_time_s;
+	params.use_exponential = use_exponential;
+	params.use_stereo = use_stereo;
+	params.use_delay = use_delay;
+	params.use_fade = use_fade;
+	params.use_diffraction = use_diffraction;
+	params.use_bspline = use_bspline;
+	params.speed_of_sound_m_s = speed_of_sound_m_s;
+	params.acoustical_size_of_head_m = acoustical_size_of_head_m;
+	params.engine = engine;
+	return params;
+}
+
+size_t ImageToSoundscapeConverter::GetMemoryUsage() const
+{
+	return GetMemoryUsage(GetParameters());
+}
+
+size_t ImageToSoundscapeConverter::GetMemoryUsage(const SoundscapeParameters &params)
+{
+	size_t usage = SynthesisTable::GetMemoryUsage(params);
+	if (params.engine == SynthesisEngine::Fft)
 	{
-		phi0[i] = TwoPi * rnd();
+		usage += FftSynthesizer::GetMemoryUsage(params) + 2 * sizeof(float) * params.GetSampleCount();
 	}
-
-	initWaveformCacheStereo();
+	return usage;
 }
 
 float ImageToSoundscapeConverter::rnd()
 {
-	static uint32_t ir = 0L;
 	uint32_t ia = 9301, ic = 49297, im = 233280;
-	ir = (ir*ia + ic) % im;
-	return ir / (1.0 * im);
+	randomSeed = (randomSeed*ia + ic) % im;
+	return randomSeed / (1.0 * im);
 }
 
 
-void ImageToSoundscapeConverter::Process(const std::vector<float> &image)
+void ImageToSoundscapeConverter::Process(const float *image, int16_t *samples)
 {
 	if (!use_stereo)
 	{
@@ -87,12 +114,31 @@ void ImageToSoundscapeConverter::Process(const std::vector<float> &image)
 	}
 	else
 	{
-		processStereo(image);
+		SynthesisState state;
+		renderStereoS16(image, 0, sampleCount, state, samples);
 	}
 }
 
+void ImageToSoundscapeConverter::Process(const float *image, float *samples)
+{
+	SynthesisState state;
+	Process(image, state, samples);
+}
 
-void ImageToSoundscapeConverter::processMono(const std::vector<float> &image)
+void ImageToSoundscapeConverter::Process(const float *image, SynthesisState &state, float *samples)
+{
+	if (!use_stereo)
+	{
+		processMono(image);
+	}
+	else
+	{
+		renderStereo(image, 0, sampleCount, state, samples);
+	}
+}
+
+
+void ImageToSoundscapeConverter::processMono(const float *image)
 {
 	throw std::runtime_error("Mono audio not implemented");
 	/*
@@ -169,13 +215,59 @@ void ImageToSoundscapeConverter::processMono(const std::vector<float> &image)
 
 
 
-void ImageToSoundscapeConverter::processStereo(const std::vector<float> &image)
+void ImageToSoundscapeConverter::ProcessColumns(const float *image, int first_column, int column_count, SynthesisState &state, int16_t *samples)
 {
-	float tau1 = 0.5 / omega[rows - 1];
-	float tau2 = 0.25 * tau1*tau1;
-	float yl = 0.0, yr = 0.0;
-	float zl = 0.0, zr = 0.0;
-	for (int sample = 0; sample < sampleCount; sample++)
+	if (!use_stereo)
+	{
+		throw std::runtime_error("Mono audio not implemented");
+	}
+
+	renderStereoS16(image, GetColumnStartSample(first_column), GetColumnStartSample(first_column + column_count), state, samples);
+}
+
+void ImageToSoundscapeConverter::ProcessColumns(const float *image, int first_column, int column_count, SynthesisState &state, float *samples)
+{
+	if (!use_stereo)
+	{
+		throw std::runtime_error("Mono audio not implemented");
+	}
+
+	renderStereo(image, GetColumnStartSample(first_column), GetColumnStartSample(first_column + column_count), state, samples);
+}
+
+uint32_t ImageToSoundscapeConverter::GetColumnStartSample(int column) const
+{
+	return table->GetColumnStartSample(column);
+}
+
+//Rendered in float blocks that stay in the L1 cache, converted to int16 all at once. The FFT engine renders
+//the whole range in one go instead, as each block would transform the frame at its end again:
+void ImageToSoundscapeConverter::renderStereoS16(const float *image, uint32_t first_sample, uint32_t end_sample, SynthesisState &state, int16_t *samples)
+{
+	if (fft)
+	{
+		renderBuffer.resize(2 * (size_t)sampleCount);
+		renderStereo(image, first_sample, end_sample, state, renderBuffer.data());
+		FloatToS16(renderBuffer.data(), samples, 2 * (end_sample - first_sample));
+		return;
+	}
+
+	const uint32_t block_frames = 512;
+	float block[2 * block_frames];
+	for (uint32_t first = first_sample; first < end_sample; first += block_frames)
+	{
+		uint32_t end = std::min(first + block_frames, end_sample);
+		renderStereo(image, first, end, state, block);
+		FloatToS16(block, &samples[2 * (first - first_sample)], 2 * (end - first));
+	}
+}
+
+//Time domain engine: row sums of samples [first_sample, end_sample) from the waveform cache, interleaved stereo.
+void ImageToSoundscapeConverter::sumRowsStereo(const float *image, uint32_t first_sample, uint32_t end_sample, float *samples)
+{
+	table->EnsureCache(first_sample, end_sample);
+
+	for (uint32_t sample = first_sample; sample < end_sample; sample++)
 	{
 		float q, q2, f1, f2;
 		if (use_bspline)
@@ -192,17 +284,9 @@ void ImageToSoundscapeConverter::processStereo(const std::vector<float> &image)
 			j = columns - 1;
 		}
 
-		float r = 1.0 * sample / (sampleCount - 1);  // Binaural attenuation/delay parameter
-		float theta = (r - 0.5) * TwoPi / 3;
-		float x = 0.5 * acoustical_size_of_head_m * (theta + sin(theta));
-		float tl = sample * timePerSample_s;
-		float tr = tl;
-		if (use_delay)
-		{
-			tr += x / speed_of_sound_m_s;  // Time delay model
-		}
-		x = fabs(x);
 		float sl = 0.0, sr = 0.0;
+		const float *cacheLeft = table->GetLeft(sample);
+		const float *cacheRight = table->GetRight(sample);
 
 		const float *im1, *im2, *im3;
 		if (j > 0)
@@ -238,8 +322,45 @@ void ImageToSoundscapeConverter::processStereo(const std::vector<float> &image)
 				a = im2[i];
 			}
 
-			sl += a * waveformCacheLeftChannel[(sample * rows) + i];
-			sr += a * waveformCacheRightChannel[(sample * rows) + i];
+			sl += a * cacheLeft[i];
+			sr += a * cacheRight[i];
+		}
+
+		samples[2 * (sample - first_sample)] = sl;
+		samples[2 * (sample - first_sample) + 1] = sr;
+	}
+}
+
+//Samples [first_sample, end_sample) of the sweep, written to samples starting at index 0.
+void ImageToSoundscapeConverter::renderStereo(const float *image, uint32_t first_sample, uint32_t end_sample, SynthesisState &state, float *samples)
+{
+	if (fft)
+	{
+		fft->Render(image, first_sample, end_sample, samples);
+	}
+	else
+	{
+		sumRowsStereo(image, first_sample, end_sample, samples);
+	}
+
+	float tau1 = 0.5 / table->GetOmega(rows - 1);
+	float tau2 = 0.25 * tau1*tau1;
+	float yl = state.yl, yr = state.yr;
+	float zl = state.zl, zr = state.zr;
+	for (uint32_t sample = first_sample; sample < end_sample; sample++)
+	{
+		float *sampleBuffer = &samples[2 * (sample - first_sample)];
+		float sl = sampleBuffer[0];
+		float sr = sampleBuffer[1];
+
+		float r = 1.0 * sample / (sampleCount - 1);  // Binaural attenuation/delay parameter
+		float theta = (r - 0.5) * TwoPi / 3;
+		float x = 0.5 * acoustical_size_of_head_m * (theta + sin(theta));
+		float tl = sample * timePerSample_s;
+		float tr = tl;
+		if (use_delay)
+		{
+			tr += x / speed_of_sound_m_s;  // Time delay model
 		}
 
 		if (sample < sampleCount / (5 * columns))
@@ -266,105 +387,12 @@ void ImageToSoundscapeConverter::processStereo(const std::vector<float> &image)
 		yr = (sr + yr * ypr + tau2 / timePerSample_s * zr) / (1.0 + yr);
 		zr = (yr - ypr) / timePerSample_s;
 
-		uint16_t* sampleBuffer = audioData.Data();
-			
-		int32_t l = 0.5 + scale * 32768.0 * yl;
-		if (l > 32767)
-		{
-			l = 32767;
-		} else if (l < -32768)
-		{
-			l = -32768;
-		}
-		sampleBuffer[2 * sample] = (uint16_t)l;
-
-		l = 0.5 + scale * 32768.0 * yr;
-		if (l > 32767)
-		{
-			l = 32767;
-		}
-		else if (l < -32768)
-		{
-			l = -32768;
-		}
-		sampleBuffer[2 * sample + 1] = (uint16_t)l;
+		sampleBuffer[0] = scale * yl;
+		sampleBuffer[1] = scale * yr;
 	}
-}
-
 
-void ImageToSoundscapeConverter::initWaveformCacheStereo()
-{
-	//waveformcache
-	float tau1 = 0.5 / omega[rows - 1];
-	float tau2 = 0.25 * tau1*tau1;
-	float q, q2;
-	float yl = 0.0, yr = 0.0;
-	float zl = 0.0, zr = 0.0;
-	for (int sample = 0; sample < sampleCount; sample++)
-	{
-		if (use_bspline)
-		{
-			q = 1.0 * (sample % samplesPerColumn) / (samplesPerColumn - 1);
-			q2 = 0.5 * q * q;
-		}
-
-		int j = sample / samplesPerColumn;
-		if (j > columns - 1)
-		{
-			j = columns - 1;
-		}
-
-		float r = 1.0 * sample / (sampleCount - 1);  // Binaural attenuation/delay parameter
-		float theta = (r - 0.5) * TwoPi / 3;
-		float x = 0.5 * acoustical_size_of_head_m * (theta + sin(theta));
-		float tl = sample * timePerSample_s;
-		float tr = tl;
-		if (use_delay)
-		{
-			tr += x / speed_of_sound_m_s;  // Time delay model
-		}
-		x = fabs(x);
-		float hrtfl = 1.0, hrtfr = 1.0;
-
-		for (int i = 0; i < rows; i++)
-		{
-			if (use_diffraction)
-			{
-				// First order frequency-dependent azimuth diffraction model
-				float hrtf;
-				if (TwoPi*speed_of_sound_m_s / omega[i] > x)
-				{
-					hrtf = 1.0;
-				}
-				else
-				{
-					hrtf = TwoPi*speed_of_sound_m_s / (x*omega[i]);
-				}
-
-				if (theta < 0.0)
-				{
-					hrtfl = 1.0;
-					hrtfr = hrtf;
-				}
-				else
-				{
-					hrtfl = hrtf;
-					hrtfr = 1.0;
-				}
-			}
-
-			if (use_fade)
-			{
-				// Simple frequency-independent relative fade model
-				hrtfl *= (1.0 - 0.7*r);
-				hrtfr *= (0.3 + 0.7*r);
-			}
-			
-			waveformCacheLeftChannel[(sample * rows) + i] = hrtfl * sin(omega[i] * tl + phi0[i]);
-			waveformCacheRightChannel[(sample * rows) + i] = hrtfr * sin(omega[i] * tr + phi0[i]);
-		}
-
-	}
-
-
-}
\ No newline at end of file
+	state.yl = yl;
+	state.yr = yr;
+	state.zl = zl;
+	state.zr = zr;
+}
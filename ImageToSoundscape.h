@@ -1,11 +1,24 @@
 #pragma once
 
-#include "AudioData.h"
 #include <string>
+#include <vector>
+#include <memory>
+#include <cinttypes>
+
+#include "SynthesisTable.h"
+#include "FftSynthesis.h"
 
 //2D indexing: column-major order, 0-based:
 #define IDX2D(row, column) (((column) * rows) + (row))
 
+//Output filter state, carried from one call of ProcessColumns() to the next.
+struct SynthesisState
+{
+	float yl, zl;
+	float yr, zr;
+
+	SynthesisState() : yl(0), zl(0), yr(0), zr(0) {}
+};
 
 class ImageToSoundscapeConverter
 {
@@ -22,6 +35,7 @@ private:
 	bool use_bspline;
 	float speed_of_sound_m_s;
 	float acoustical_size_of_head_m;
+	SynthesisEngine engine;
 
 	int rows;
 	int columns;
@@ -31,27 +45,52 @@ private:
 	const float timePerSample_s;
 	const float scale;
 
-	std::vector<float> omega;
-	std::vector<float> phi0;
-	std::vector<float> waveformCacheLeftChannel;
-	std::vector<float> waveformCacheRightChannel;
+	uint32_t randomSeed; //for the clicks, per converter
+
+	std::shared_ptr<SynthesisTable> table; //shared with the registry's converters with the same parameters
+	std::unique_ptr<FftSynthesizer> fft; //FFT engine only
+	std::vector<float> renderBuffer; //FFT engine, int16 output
 
-	AudioData audioData;
+	ImageToSoundscapeConverter(const ImageToSoundscapeConverter& other) = delete;
+	ImageToSoundscapeConverter& operator=(const ImageToSoundscapeConverter&) = delete;
 
 	float rnd(void);
 
-	void initWaveformCacheStereo();
-	void processMono(const std::vector<float> &image);
-	void processStereo(const std::vector<float> &image);
+	void processMono(const float *image);
+	void sumRowsStereo(const float *image, uint32_t first_sample, uint32_t end_sample, float *samples);
+	void renderStereo(const float *image, uint32_t first_sample, uint32_t end_sample, SynthesisState &state, float *samples);
+	void renderStereoS16(const float *image, uint32_t first_sample, uint32_t end_sample, SynthesisState &state, int16_t *samples);
 public:
 
 	ImageToSoundscapeConverter(int rows, int columns, double freq_lowest = 500, double freq_highest = 5000,
 							   int sample_freq_Hz = 44100, double total_time_s = 1.05, bool use_exponential = true,
 							   bool use_stereo = true, bool use_delay = true, bool use_fade = true,
 							   bool use_diffraction = true, bool use_bspline = true, float speed_of_sound_m_s = 340,
-							   float acoustical_size_of_head_m = 0.20);
+							   float acoustical_size_of_head_m = 0.20, SynthesisEngine engine = SynthesisEngine::Cache,
+							   bool lazy_cache = false, SynthesisTableRegistry *registry = nullptr);
+	//lazy_cache: return before the waveform cache is complete, missing parts are built on first use.
+	//registry: share the table with its other converters, only used here. nullptr: a table of its own.
+	ImageToSoundscapeConverter(const SoundscapeParameters &params, bool lazy_cache = false, SynthesisTableRegistry *registry = nullptr);
 
-	void Process(const std::vector<float> &image);
-	AudioData& GetAudioData() { return audioData; }
+	SoundscapeParameters GetParameters() const;
+	size_t GetMemoryUsage() const;
+	//Memory needed by a converter with params, if no other converter shares its table.
+	static size_t GetMemoryUsage(const SoundscapeParameters &params);
+	//Renders the whole soundscape of image (rows * columns amplitudes, see IDX2D) as interleaved samples
+	//into the caller's buffer of GetFrameCount() * GetChannels() samples.
+	//Float samples are not clipped, int16 samples are clipped at full scale.
+	void Process(const float *image, int16_t *samples);
+	void Process(const float *image, float *samples);
+	//Same, with the output filter state carried over from the previous soundscape, so frames join without a step.
+	void Process(const float *image, SynthesisState &state, float *samples);
+	//Continuous sweep: renders columns [first_column, first_column + column_count) as interleaved stereo
+	//into samples, which must hold GetColumnStartSample(first_column + column_count) - GetColumnStartSample(first_column) frames.
+	void ProcessColumns(const float *image, int first_column, int column_count, SynthesisState &state, int16_t *samples);
+	void ProcessColumns(const float *image, int first_column, int column_count, SynthesisState &state, float *samples);
+	uint32_t GetColumnStartSample(int column) const;
+	int GetColumns() const { return columns; }
+	int GetSampleFreq() const { return sample_freq_Hz; }
+	int GetFrameCount() const { return sampleCount; }
+	int GetChannels() const { return use_stereo ? 2 : 1; }
 };
 
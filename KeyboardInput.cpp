@@ -202,6 +202,8 @@ std::string KeyboardInput::GetInteractiveCommandList()
 	cmdlist << "6: Brightness [low, normal, high]" << std::endl;
 	cmdlist << "7: Contrast [x1, x2, x3]" << std::endl;
 	cmdlist << "8: Foveal mapping [off, on]" << std::endl;
+	cmdlist << "9: Scan time [0.5s, 1.05s, 2s]" << std::endl;
+	cmdlist << "*: Resolution [32x88, 64x176, 128x352]" << std::endl;
 	cmdlist << ".: Restore defaults" << std::endl;
 	cmdlist << "q, [Escape]: Quit" << std::endl;
 
@@ -210,7 +212,7 @@ std::string KeyboardInput::GetInteractiveCommandList()
 
 std::string KeyboardInput::KeyPressedAction(int ch)
 {
-	std::vector<int> option_cycle{ '0', '1', '2', '3', '4', '5', '6', '7', '8', '.' }; //, '+', '-', 'q' };
+	std::vector<int> option_cycle{ '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '*', '.' }; //, '+', '-', 'q' };
 
 	bool option_changed = false;
 	int changevalue = 0; //-1: decrease value, 0: no change, 1: increase value, 2: cycle values
@@ -290,6 +292,12 @@ std::string KeyboardInput::KeyPressedAction(int ch)
 			case '8':
 				state_str << "foveal mapping";
 				break;
+			case '9':
+				state_str << "scan time";
+				break;
+			case '*':
+				state_str << "resolution";
+				break;
 			case '+':
 				state_str << "volume up";
 				break;
@@ -370,6 +378,19 @@ std::string KeyboardInput::KeyPressedAction(int ch)
 				rvopt.foveal_mapping = !rvopt.foveal_mapping;
 				state_str << (rvopt.foveal_mapping ? "foveal mapping on" : "foveal mapping off");
 				break;
+			case '9':
+				cycleValues(rvopt.total_time_s, { 0.5, 1.05, 2.0 }, changevalue);
+				state_str << "scan time " << rvopt.total_time_s << " seconds";
+				break;
+			case '*':
+				cycleValues(rvopt.rows, { 32, 64, 128 }, changevalue);
+				rvopt.columns = rvopt.rows * 11 / 4;
+				if (rvopt.blinders != 0)
+				{
+					rvopt.blinders = rvopt.columns / 4;
+				}
+				state_str << "resolution " << rvopt.rows << " by " << rvopt.columns;
+				break;
 			case '+':
 				cycleValues(rvopt.volume, { 1, 2, 4, 8, 16, 32, 64, 100 }, (changevalue > 0) ? 1: -1);
 				newvolume = rvopt.volume;
@@ -574,6 +595,19 @@ void KeyboardInput::cycleValues(float &current_value, std::vector<float> value_l
 	current_value = value_list[0];
 }
 
+void KeyboardInput::cycleValues(double &current_value, std::vector<double> value_list, int changevalue)
+{
+	for (int i = 0; i < value_list.size(); i++)
+	{
+		if (fabs(current_value - value_list[i]) < 1e-10)
+		{
+			current_value = value_list[changeIndex(i, value_list.size() - 1, changevalue)];
+			return;
+		}
+	}
+	current_value = value_list[0];
+}
+
 void KeyboardInput::cycleValues(int &current_value, std::vector<int> value_list, int changevalue)
 {
 	for (int i = 0; i < value_list.size(); i++)
@@ -31,6 +31,7 @@ private:
 	int changeIndex(int i, int maxindex, int changevalue);
 	void cycleValues(int &current_value, std::vector<int> value_list, int changevalue);
 	void cycleValues(float &current_value, std::vector<float> value_list, int changevalue);
+	void cycleValues(double &current_value, std::vector<double> value_list, int changevalue);
 public:
 	bool Verbose;
 
@@ -1,6 +1,7 @@
 #include <string>
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 #include "Options.h"
 
@@ -9,6 +10,29 @@ RaspiVoiceOptions cmdLineOptions;
 RaspiVoiceOptions rvopt;
 pthread_mutex_t rvopt_mutex;
 
+//Options without a short form:
+enum
+{
+	OPT_SHARED_MEMORY_NAME = 256,
+	OPT_PCM_STREAM,
+	OPT_RECORD,
+	OPT_RECORD_SEGMENT_S,
+	OPT_CONTINUOUS,
+	OPT_LAZY_CACHE,
+	OPT_OUTPUT_FORMAT,
+	OPT_DITHER,
+	OPT_CROSSFADE_MS,
+	OPT_NO_LIMITER,
+	OPT_LIMITER_CEILING_DB,
+	OPT_LIMITER_LOOKAHEAD_MS,
+	OPT_LIMITER_RELEASE_MS,
+	OPT_AGC,
+	OPT_AGC_TARGET_DB,
+	OPT_AGC_MAX_GAIN_DB,
+	OPT_AGC_TIME_S,
+	OPT_SYNTHESIS_ENGINE
+};
+
 static struct option long_getopt_options[] =
 {
 	{ "help", no_argument, 0, 'h' },
@@ -17,26 +41,49 @@ static struct option long_getopt_options[] =
 	{ "columns", required_argument, 0, 'c' },
 	{ "image_source", required_argument, 0, 's' },
 	{ "input_filename", required_argument, 0, 'i' },
+	{ "v4l2", no_argument, 0, 'U' },
+	{ "shared_memory_name", required_argument, 0, OPT_SHARED_MEMORY_NAME },
 	{ "output_filename", required_argument, 0, 'o' },
+	{ "pcm_stream", required_argument, 0, OPT_PCM_STREAM },
+	{ "record", required_argument, 0, OPT_RECORD },
+	{ "record_segment_s", required_argument, 0, OPT_RECORD_SEGMENT_S },
 	{ "audio_card", required_argument, 0, 'a' },
+	{ "output_format", required_argument, 0, OPT_OUTPUT_FORMAT },
+	{ "dither", no_argument, 0, OPT_DITHER },
+	{ "no_limiter", no_argument, 0, OPT_NO_LIMITER },
+	{ "limiter_ceiling_db", required_argument, 0, OPT_LIMITER_CEILING_DB },
+	{ "limiter_lookahead_ms", required_argument, 0, OPT_LIMITER_LOOKAHEAD_MS },
+	{ "limiter_release_ms", required_argument, 0, OPT_LIMITER_RELEASE_MS },
+	{ "agc", no_argument, 0, OPT_AGC },
+	{ "agc_target_db", required_argument, 0, OPT_AGC_TARGET_DB },
+	{ "agc_max_gain_db", required_argument, 0, OPT_AGC_MAX_GAIN_DB },
+	{ "agc_time_s", required_argument, 0, OPT_AGC_TIME_S },
 	{ "volume", required_argument, 0, 'V' },
 	{ "preview", no_argument, 0, 'p' },
+	{ "preview_fps", required_argument, 0, 'j' },
+	{ "preview_overlay", no_argument, 0, 'w' },
 	{ "use_bw_test_image", required_argument, 0, 'I' },
 	{ "verbose", no_argument, 0, 'v' },
 	{ "negative_image", no_argument, 0, 'n' },
 	{ "flip", required_argument, 0, 'f' },
 	{ "read_frames", required_argument, 0, 'R' },
+	{ "frame_averaging", required_argument, 0, 'Q' },
+	{ "averaging_weight", required_argument, 0, 'Y' },
 	{ "exposure", required_argument, 0, 'e' },
 	{ "brightness", required_argument, 0, 'B' },
 	{ "contrast", required_argument, 0, 'C' },
+	{ "auto_contrast", required_argument, 0, 'u' },
 	{ "blinders", required_argument, 0, 'b' },
 	{ "zoom", required_argument, 0, 'z' },
 	{ "foveal_mapping", no_argument, 0, 'm' },
 	{ "edge_detection_opacity", required_argument, 0, 'E' },
 	{ "edge_detection_threshold", required_argument, 0, 'G' },
+	{ "edge_detection_mode", required_argument, 0, 'W' },
 	{ "freq_lowest", required_argument, 0, 'L' },
 	{ "freq_highest", required_argument, 0, 'H' },
 	{ "total_time_s", required_argument, 0, 't' },
+	{ "continuous", no_argument, 0, OPT_CONTINUOUS },
+	{ "crossfade_ms", required_argument, 0, OPT_CROSSFADE_MS },
 	{ "use_exponential", required_argument, 0, 'x' },
 	{ "use_delay", required_argument, 0, 'y' },
 	{ "use_fade", required_argument, 0, 'F' },
@@ -48,6 +95,12 @@ static struct option long_getopt_options[] =
 	{ "grab_keyboard", required_argument, 0, 'g' },
 	{ "use_rotary_encoder", no_argument, 0, 'A' },
 	{ "speak", no_argument, 0, 'S' },
+	{ "synthesis_engine", required_argument, 0, OPT_SYNTHESIS_ENGINE },
+	{ "converter_cache_mb", required_argument, 0, 'M' },
+	{ "lazy_cache", no_argument, 0, OPT_LAZY_CACHE },
+	{ "speech_cache_dir", required_argument, 0, 'P' },
+	{ "speech_ducking", required_argument, 0, 'K' },
+	{ "benchmark", no_argument, 0, 'X' },
 	{ 0, 0, 0, 0 }
 }; 
 
@@ -59,28 +112,51 @@ RaspiVoiceOptions GetDefaultOptions()
 	opt.columns = 176;
 	opt.image_source = 1;
 	opt.input_filename = "";
+	opt.use_v4l2 = false;
+	opt.shared_memory_name = "/raspivoice_frames";
 	opt.output_filename = "";
+	opt.pcm_stream = "";
+	opt.record_prefix = "";
+	opt.record_segment_s = 600;
 	opt.audio_card = 0;
+	opt.output_format = 0;
+	opt.dither = false;
+	opt.limiter = true;
+	opt.limiter_ceiling_db = -1.0;
+	opt.limiter_lookahead_ms = 5.0;
+	opt.limiter_release_ms = 100.0;
+	opt.agc = false;
+	opt.agc_target_db = -20.0;
+	opt.agc_max_gain_db = 12.0;
+	opt.agc_time_s = 3.0;
 	opt.volume = -1;
 	opt.preview = false;
+	opt.preview_fps = 10;
+	opt.preview_overlay = false;
 	opt.use_bw_test_image = false;
 	opt.verbose = false;
 	opt.negative_image = false;
 	opt.flip = 0;
 	opt.read_frames = 2;
+	opt.frame_averaging = 0;
+	opt.averaging_weight = 0.5;
 	opt.exposure = 0;
 	opt.brightness = 0;
 	opt.contrast = 1.0;
+	opt.auto_contrast = 0.0;
 	opt.blinders = 0;
 	opt.zoom = 1;
 	opt.foveal_mapping = false;
 	opt.threshold = 0;
 	opt.edge_detection_opacity = 0.0;
 	opt.edge_detection_threshold = 50;
+	opt.edge_detection_mode = 0;
 	opt.freq_lowest = 500;
 	opt.freq_highest = 5000;
 	opt.sample_freq_Hz = 48000;
 	opt.total_time_s = 1.05;
+	opt.continuous = false;
+	opt.crossfade_ms = 0;
 	opt.use_exponential = true;
 	opt.use_stereo = true;
 	opt.use_delay = true;
@@ -89,11 +165,17 @@ RaspiVoiceOptions GetDefaultOptions()
 	opt.use_bspline = true;
 	opt.speed_of_sound_m_s = 340;
 	opt.acoustical_size_of_head_m = 0.20;
+	opt.synthesis_engine = 0;
+	opt.converter_cache_mb = 64;
+	opt.lazy_cache = false;
 	opt.mute = false;
 	opt.daemon = false;
 	opt.grab_keyboard = "";
 	opt.use_rotary_encoder = false;
 	opt.speak = false;
+	opt.speech_cache_dir = "/var/tmp/raspivoice/speech";
+	opt.speech_ducking = 0.3;
+	opt.benchmark = false;
 
 	opt.quit = false;
 
@@ -109,7 +191,7 @@ bool SetCommandLineOptions(int argc, char *argv[])
 	//Retrieve command line options:
 	int option_index = 0;
 	int cmdline_opt;
-	while ((cmdline_opt = getopt_long_only(argc, argv, "hdr:c:s:i:o:a:V:pI:vnf:R:e:B:C:b:z:mE:G:L:H:t:x:y:d:F:D:N:Z:T:O:g:AS", long_getopt_options, &option_index)) != -1)
+	while ((cmdline_opt = getopt_long_only(argc, argv, "hdr:c:s:i:o:a:V:pI:vnf:R:e:B:C:b:z:mE:G:L:H:t:x:y:d:F:D:N:Z:T:O:g:ASM:P:K:UW:XQ:Y:j:wu:", long_getopt_options, &option_index)) != -1)
 	{
 		switch (cmdline_opt)
 		{
@@ -133,9 +215,58 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 'i':
 				opt.input_filename = optarg;
 				break;
+			case 'U':
+				opt.use_v4l2 = true;
+				break;
+			case OPT_SHARED_MEMORY_NAME:
+				opt.shared_memory_name = optarg;
+				break;
 			case 'o':
 				opt.output_filename = optarg;
 				break;
+			case OPT_PCM_STREAM:
+				opt.pcm_stream = optarg;
+				break;
+			case OPT_OUTPUT_FORMAT:
+				opt.output_format = atoi(optarg);
+				if ((opt.output_format < 0) || (opt.output_format > 3))
+				{
+					opt.output_format = 0;
+				}
+				break;
+			case OPT_DITHER:
+				opt.dither = true;
+				break;
+			case OPT_NO_LIMITER:
+				opt.limiter = false;
+				break;
+			case OPT_LIMITER_CEILING_DB:
+				opt.limiter_ceiling_db = std::min((float)atof(optarg), 0.0f);
+				break;
+			case OPT_LIMITER_LOOKAHEAD_MS:
+				opt.limiter_lookahead_ms = std::max((float)atof(optarg), 0.0f);
+				break;
+			case OPT_LIMITER_RELEASE_MS:
+				opt.limiter_release_ms = std::max((float)atof(optarg), 1.0f);
+				break;
+			case OPT_AGC:
+				opt.agc = true;
+				break;
+			case OPT_AGC_TARGET_DB:
+				opt.agc_target_db = std::min((float)atof(optarg), 0.0f);
+				break;
+			case OPT_AGC_MAX_GAIN_DB:
+				opt.agc_max_gain_db = std::max((float)atof(optarg), 0.0f);
+				break;
+			case OPT_AGC_TIME_S:
+				opt.agc_time_s = std::max((float)atof(optarg), 0.1f);
+				break;
+			case OPT_RECORD:
+				opt.record_prefix = optarg;
+				break;
+			case OPT_RECORD_SEGMENT_S:
+				opt.record_segment_s = atoi(optarg);
+				break;
 			case 'a':
 				opt.audio_card = atoi(optarg);
 				break;
@@ -145,6 +276,12 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 'p':
 				opt.preview = true;
 				break;
+			case 'j':
+				opt.preview_fps = atoi(optarg);
+				break;
+			case 'w':
+				opt.preview_overlay = true;
+				break;
 			case 'I':
 				opt.use_bw_test_image = (atoi(optarg) != 0);
 				break;
@@ -163,6 +300,9 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 'G':
 				opt.edge_detection_threshold = atoi(optarg);
 				break;
+			case 'W':
+				opt.edge_detection_mode = atoi(optarg);
+				break;
 			case 'L':
 				opt.freq_lowest = atof(optarg);
 				break;
@@ -172,6 +312,12 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 't':
 				opt.total_time_s = atof(optarg);
 				break;
+			case OPT_CONTINUOUS:
+				opt.continuous = true;
+				break;
+			case OPT_CROSSFADE_MS:
+				opt.crossfade_ms = std::max(atoi(optarg), 0);
+				break;
 			case 'x':
 				opt.use_exponential = (atoi(optarg) != 0);
 				break;
@@ -184,6 +330,12 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 'R':
 				opt.read_frames = atoi(optarg);
 				break;
+			case 'Q':
+				opt.frame_averaging = atoi(optarg);
+				break;
+			case 'Y':
+				opt.averaging_weight = atof(optarg);
+				break;
 			case 'e':
 				opt.exposure = atoi(optarg);
 				break;
@@ -193,6 +345,9 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 'C':
 				opt.contrast = atof(optarg);
 				break;
+			case 'u':
+				opt.auto_contrast = atof(optarg);
+				break;
 			case 'b':
 				opt.blinders = atoi(optarg);
 				break;
@@ -226,6 +381,24 @@ bool SetCommandLineOptions(int argc, char *argv[])
 			case 'S':
 				opt.speak = true;
 				break;
+			case 'M':
+				opt.converter_cache_mb = atoi(optarg);
+				break;
+			case OPT_SYNTHESIS_ENGINE:
+				opt.synthesis_engine = (atoi(optarg) == 1) ? 1 : 0;
+				break;
+			case OPT_LAZY_CACHE:
+				opt.lazy_cache = true;
+				break;
+			case 'P':
+				opt.speech_cache_dir = optarg;
+				break;
+			case 'K':
+				opt.speech_ducking = atof(optarg);
+				break;
+			case 'X':
+				opt.benchmark = true;
+				break;
 			default:
 				std::cout << "Type raspivoice --help for available options." << std::endl;
 				return false;
@@ -251,6 +424,13 @@ RaspiVoiceOptions GetCommandLineOptions()
 }
 
 
+//The rate negotiated with the audio device, so resetting to the command line options keeps rendering at it:
+void SetCommandLineSampleFreq(int sample_freq_Hz)
+{
+	cmdLineOptions.sample_freq_Hz = sample_freq_Hz;
+}
+
+
 void ShowHelp()
 {
 	std::cout << "Usage: " << std::endl;
@@ -261,31 +441,56 @@ void ShowHelp()
 	std::cout << "-d  --daemon\t\t\t\tDaemon mode (run in background)" << std::endl;
 	std::cout << "-r, --rows=[64]\t\t\t\tNumber of rows, i.e. vertical (frequency) soundscape resolution (ignored if test image is used)" << std::endl;
 	std::cout << "-c, --columns=[178]\t\t\tNumber of columns, i.e. horizontal (time) soundscape resolution (ignored if test image is used)" << std::endl;
-	std::cout << "-s, --image_source=[1]\t\t\tImage source: 0 for image file, 1 for RaspiCam, 2 for 1st USB camera, 3 for 2nd USB camera..." << std::endl;
+	std::cout << "-s, --image_source=[1]\t\t\tImage source: 0 for image file, 1 for RaspiCam, 2 for 1st USB camera, 3 for 2nd USB camera..., -1 for shared memory frames" << std::endl;
+	std::cout << "    --shared_memory_name=[/raspivoice_frames]\tShared memory frame ring for image_source -1, see SharedFrameRing.h." << std::endl;
+	std::cout << "-U, --v4l2\t\t\t\tCapture USB cameras directly with V4L2 (GREY/YUYV), no color conversion." << std::endl;
 	std::cout << "-i, --input_filename=[]\t\t\tPath to image file (bmp,jpg,png,ppm,tif). Reread every frame. Static test image is used if empty." << std::endl;
 	std::cout << "-o, --output_filename=[]\t\tPath to output file (wav). Written every frame if not muted." << std::endl;
+	std::cout << "    --pcm_stream=[]\t\t\tStream the audio output as raw PCM with header: - for stdout, FIFO path, or unix:/socket/path." << std::endl;
+	std::cout << "    --record=[]\t\t\t\tRecord all played soundscapes to <prefix>_<date>_<time>_<n>.wav segment files." << std::endl;
+	std::cout << "    --record_segment_s=[600]\t\tLength of recording segments in seconds of audio." << std::endl;
 	std::cout << "-a, --audio_card=[0]\t\t\tAudio card number (0,1,...), use aplay -l to get list" << std::endl;
+	std::cout << "    --output_format=[0]\t\t\tSample format of the audio device and WAV files: 0: 16 bit, 1: 24 bit, 2: 32 bit, 3: float. The device falls back to its best native format." << std::endl;
+	std::cout << "    --dither\t\t\t\tTPDF dither when the output is reduced to 16 bits." << std::endl;
+	std::cout << "    --no_limiter\t\t\tClip the audio output instead of limiting it." << std::endl;
+	std::cout << "    --limiter_ceiling_db=[-1]\t\tPeak level of the limited audio output in dBFS." << std::endl;
+	std::cout << "    --limiter_lookahead_ms=[5]\t\tLimiter look-ahead, also its added latency." << std::endl;
+	std::cout << "    --limiter_release_ms=[100]\t\tLimiter release time after a peak." << std::endl;
+	std::cout << "    --agc\t\t\t\tAutomatic gain control of the soundscape level." << std::endl;
+	std::cout << "    --agc_target_db=[-20]\t\tSoundscape RMS level the AGC steers to, in dBFS." << std::endl;
+	std::cout << "    --agc_max_gain_db=[12]\t\tMaximum AGC gain, also the maximum attenuation." << std::endl;
+	std::cout << "    --agc_time_s=[3]\t\t\tAGC time constant in seconds." << std::endl;
 	std::cout << "-V, --volume=[-1]\t\t\tAudio volume (set by system mixer, 0-100, -1 for no change)" << std::endl;
 	std::cout << "-S, --speak\t\t\t\tSpeak out option changes (espeak)." << std::endl;
+	std::cout << "-P, --speech_cache_dir=[/var/tmp/raspivoice/speech]\tDirectory for prerendered announcements. Empty for memory only." << std::endl;
+	std::cout << "-K, --speech_ducking=[0.3]\t\tSoundscape volume factor while speaking (0.0-1.0, 1.0 for no ducking)." << std::endl;
 	std::cout << "-g  --grab_keyboard=[]\t\t\tGrab keyboard device for exclusive access. Use device number(s) 0,1,2... (comma separated without spaces) from /dev/input/event*" << std::endl;
 	std::cout << "-A  --use_rotary_encoder\t\tUse rotary encoder on GPIO" << std::endl;
 	std::cout << "-p, --preview\t\t\t\tOpen preview window(s). X server required." << std::endl;
+	std::cout << "-j, --preview_fps=[10]\t\t\tMaximum preview window updates per second." << std::endl;
+	std::cout << "-w, --preview_overlay\t\t\tShow stage timings and the column being played in the preview." << std::endl;
 	std::cout << "-v, --verbose\t\t\t\tVerbose outputs." << std::endl;
 	std::cout << "-n, --negative_image\t\t\tSwap bright and dark." << std::endl;
 	std::cout << "-f, --flip=[0]\t\t\t\t0: no flipping, 1: horizontal, 2: verticel, 3: both" << std::endl;
 	std::cout << "-R, --read_frames=[2]\t\t\tSet number of frames to read from camera before processing (>= 1). Optimize for minimal lag." << std::endl;
+	std::cout << "-Q  --frame_averaging=[0]\t\t0: use last frame read, 1: average all read_frames, 2: moving average over soundscapes (reduces noise)." << std::endl;
+	std::cout << "-Y  --averaging_weight=[0.5]\t\tWeight of the newest frame for frame_averaging=2 (0.0-1.0, 1.0 for no averaging)." << std::endl;
 	std::cout << "-e  --exposure=[0]\t\t\tCamera exposure time setting, 1-100. Use 0 for auto." << std::endl;
 	std::cout << "-B  --brightness=[0]\t\t\tAdditional brightness, -255 to 255." << std::endl;
 	std::cout << "-C  --contrast=[1.0]\t\t\tContrast enhancement factor >= 1.0" << std::endl;
+	std::cout << "-u  --auto_contrast=[0.0]\t\tStretch the brightness range to full contrast, ignoring this percentage of darkest and brightest pixels. 0 for off." << std::endl;
 	std::cout << "-b  --blinders=[0]\t\t\tBlinders left and right, pixel size (0-89 for default columns)" << std::endl;
 	std::cout << "-z  --zoom=[1.0]\t\t\tZoom factor (>= 1.0)" << std::endl;
 	std::cout << "-m  --foveal_mapping\t\t\tEnable foveal mapping (barrel distortion magnifying center region)" << std::endl;
 	std::cout << "-T, --threshold=[0]\t\t\tEnable threshold for black/white image if > 0. Range 1-255, use 127 as a starting point. 255=auto." << std::endl;
 	std::cout << "-E, --edge_detection_opacity=[0.0]\tEnable edge detection if > 0. Opacity of detected edges between 0.0 and 1.0." << std::endl;
 	std::cout << "-G  --edge_detection_threshold=[50]\tEdge detection threshold value 1-255." << std::endl;
+	std::cout << "-W  --edge_detection_mode=[0]\t\t0: Canny, 1: fast integer gradient (cheaper, thicker edges)." << std::endl;
 	std::cout << "-L, --freq_lowest=[500]" << std::endl;
 	std::cout << "-H, --freq_highest=[5000]" << std::endl;
 	std::cout << "-t, --total_time_s=[1.05]" << std::endl;
+	std::cout << "    --continuous\t\t\tContinuous sweep: each column is played from the newest frame (output_filename is not written)." << std::endl;
+	std::cout << "    --crossfade_ms=[0]\t\t\tOverlap of consecutive soundscapes, the next one is faded in (not with --continuous)." << std::endl;
 	std::cout << "-x  --use_exponential=[1]" << std::endl;
 	//std::cout << "-o  --use_stereo=[1]" << std::endl;
 	std::cout << "-d, --use_delay=[1]" << std::endl;
@@ -293,5 +498,9 @@ void ShowHelp()
 	std::cout << "-D  --use_diffraction=[1]" << std::endl;
 	std::cout << "-N  --use_bspline=[1]" << std::endl;
 	std::cout << "-Z  --sample_freq_Hz=[48000]" << std::endl;
+	std::cout << "    --synthesis_engine=[0]\t\t0: time domain with waveform cache, 1: FFT overlap-add without cache, faster for many rows (256-512)." << std::endl;
+	std::cout << "-M  --converter_cache_mb=[64]\t\tMemory limit for prebuilt converters kept for instant parameter switching" << std::endl;
+	std::cout << "    --lazy_cache\t\t\t\tStart playing while the waveform cache is still being built (faster time to first sound)." << std::endl;
+	std::cout << "-X  --benchmark\t\t\t\tTime the processing stages with the given options and exit." << std::endl;
 	std::cout << std::endl;
 }
\ No newline at end of file
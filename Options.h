@@ -8,29 +8,52 @@ typedef struct
 	int rows;
 	int columns;
 	int image_source;
+	bool use_v4l2;
+	std::string shared_memory_name;
 	std::string input_filename;
 	std::string output_filename;
+	std::string pcm_stream;
+	std::string record_prefix;
+	int record_segment_s;
 	int audio_card;
+	int output_format;
+	bool dither;
+	bool limiter;
+	float limiter_ceiling_db;
+	float limiter_lookahead_ms;
+	float limiter_release_ms;
+	bool agc;
+	float agc_target_db;
+	float agc_max_gain_db;
+	float agc_time_s;
 	int volume;
 	bool preview;
+	int preview_fps;
+	bool preview_overlay;
 	bool use_bw_test_image;
 	bool verbose;
 	bool negative_image;
 	int flip;
 	int read_frames;
+	int frame_averaging;
+	float averaging_weight;
 	int exposure;
 	int brightness;
 	float contrast;
+	float auto_contrast;
 	int blinders;
 	float zoom;
 	bool foveal_mapping;
 	int threshold;
 	float edge_detection_opacity;
 	int edge_detection_threshold;
+	int edge_detection_mode;
 	double freq_lowest;
 	double freq_highest;
 	int	sample_freq_Hz;
 	double total_time_s;
+	bool continuous;
+	int crossfade_ms;
 	bool use_exponential;
 	bool use_stereo;
 	bool use_delay;
@@ -39,11 +62,17 @@ typedef struct
 	bool use_bspline;
 	float speed_of_sound_m_s;
 	float acoustical_size_of_head_m;
+	int synthesis_engine;
+	int converter_cache_mb;
+	bool lazy_cache;
 	bool mute;
 	bool daemon;
 	std::string grab_keyboard;
 	bool use_rotary_encoder;
 	bool speak;
+	std::string speech_cache_dir;
+	float speech_ducking;
+	bool benchmark;
 
 	bool quit;
 } RaspiVoiceOptions;
@@ -54,4 +83,5 @@ extern pthread_mutex_t rvopt_mutex;
 RaspiVoiceOptions GetDefaultOptions(void);
 bool SetCommandLineOptions(int argc, char *argv[]);
 RaspiVoiceOptions GetCommandLineOptions();
+void SetCommandLineSampleFreq(int sample_freq_Hz);
 void ShowHelp(void);
@@ -0,0 +1,234 @@
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "PcmStreamSink.h"
+
+PcmStreamSink::PcmStreamSink(std::string target, int sample_freq_Hz, int channels, int buffer_ms, bool verbose) :
+	target(target),
+	sample_freq_Hz(sample_freq_Hz),
+	channels(channels),
+	verbose(verbose),
+	fd(-1),
+	is_stdout(target == "-"),
+	ring((size_t)sample_freq_Hz * channels * buffer_ms / 1000),
+	dropped_frames(0),
+	quit(false)
+{
+	//A reader going away must not kill the program:
+	signal(SIGPIPE, SIG_IGN);
+
+	if (is_stdout)
+	{
+		//Keep the real stdout for samples, text output goes to stderr from now on:
+		fflush(stdout);
+		fd = dup(STDOUT_FILENO);
+		if (fd == -1)
+		{
+			throw(std::runtime_error("Cannot duplicate stdout for PCM stream."));
+		}
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+
+	if (pthread_create(&writer_thread, NULL, runWriterThread, this))
+	{
+		throw(std::runtime_error("Error setting up PCM stream thread."));
+	}
+}
+
+PcmStreamSink::~PcmStreamSink()
+{
+	quit = true;
+	pthread_join(writer_thread, nullptr);
+	closeTarget();
+
+	if (verbose && (dropped_frames > 0))
+	{
+		std::cout << "PCM stream: " << dropped_frames << " frames dropped" << std::endl;
+	}
+}
+
+void PcmStreamSink::Write(const int16_t *samples, size_t frame_count)
+{
+	if (!ring.Write(samples, frame_count * channels))
+	{
+		dropped_frames += frame_count;
+	}
+}
+
+void *PcmStreamSink::runWriterThread(void *arg)
+{
+	static_cast<PcmStreamSink*>(arg)->writerLoop();
+	return nullptr;
+}
+
+//Non-blocking open, so a missing reader never stalls the thread. Writes the header.
+bool PcmStreamSink::openTarget()
+{
+	if (!is_stdout)
+	{
+		if (target.compare(0, 5, "unix:") == 0)
+		{
+			struct sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			strncpy(addr.sun_path, target.c_str() + 5, sizeof(addr.sun_path) - 1);
+
+			fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if ((fd != -1) && (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1))
+			{
+				close(fd);
+				fd = -1;
+			}
+		}
+		else
+		{
+			//Fails with ENXIO on a FIFO without reader:
+			fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+		}
+
+		if (fd == -1)
+		{
+			return false;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+
+	PcmStreamHeader header;
+	memcpy(header.magic, "RVPC", 4);
+	header.version = 1;
+	header.sample_freq_Hz = sample_freq_Hz;
+	header.channels = channels;
+	header.bits_per_sample = 16;
+	if (!writeAll(&header, sizeof(header)))
+	{
+		closeTarget();
+		return false;
+	}
+
+	if (verbose)
+	{
+		std::cout << "PCM stream connected: " << target << std::endl;
+	}
+	return true;
+}
+
+void PcmStreamSink::closeTarget()
+{
+	if (fd != -1)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+//Waits for the reader as long as needed, returns false if it went away or on quit.
+bool PcmStreamSink::writeAll(const void *data, size_t size)
+{
+	const char *p = (const char*)data;
+	while (size > 0)
+	{
+		ssize_t written = write(fd, p, size);
+		if (written > 0)
+		{
+			p += written;
+			size -= written;
+			continue;
+		}
+		if ((written == -1) && (errno != EAGAIN) && (errno != EINTR))
+		{
+			return false;
+		}
+
+		struct pollfd pfd = { fd, POLLOUT, 0 };
+		poll(&pfd, 1, 100);
+		if (quit)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void PcmStreamSink::writerLoop()
+{
+	bool connected = false;
+	bool stdout_closed = false;
+	uint64_t reported_drops = 0;
+	struct timespec idle = { 0, 10000000L }; //10 ms
+	struct timespec retry = { 0, 200000000L }; //200 ms
+
+	while (!quit)
+	{
+		if (!connected && !stdout_closed)
+		{
+			connected = openTarget();
+		}
+
+		size_t count;
+		const int16_t *samples = ring.Peek(count);
+		if (!connected)
+		{
+			//Nobody is listening, discard instead of dropping later:
+			ring.Consume(count);
+			nanosleep(&retry, NULL);
+			continue;
+		}
+		if (count == 0)
+		{
+			nanosleep(&idle, NULL);
+			continue;
+		}
+
+		//Whole frames only, the ring may wrap inside a frame:
+		size_t frames = count / channels;
+		if (frames == 0)
+		{
+			int16_t frame[8];
+			count = ring.Read(frame, channels);
+			if (!writeAll(frame, count * sizeof(int16_t)))
+			{
+				connected = false;
+			}
+		}
+		else
+		{
+			if (!writeAll(samples, frames * channels * sizeof(int16_t)))
+			{
+				connected = false;
+			}
+			ring.Consume(frames * channels);
+		}
+
+		if (!connected)
+		{
+			if (verbose)
+			{
+				std::cout << "PCM stream reader disconnected: " << target << std::endl;
+			}
+			if (is_stdout)
+			{
+				stdout_closed = true;
+			}
+			else
+			{
+				closeTarget();
+			}
+		}
+
+		if (verbose && (dropped_frames != reported_drops))
+		{
+			reported_drops = dropped_frames;
+			std::cout << "PCM stream overrun, " << reported_drops << " frames dropped" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cinttypes>
+#include <pthread.h>
+
+#include "SpscRing.h"
+
+//Header sent at the start of every connection, little endian, followed by interleaved samples.
+struct PcmStreamHeader
+{
+	char magic[4]; //"RVPC"
+	uint32_t version;
+	uint32_t sample_freq_Hz;
+	uint16_t channels;
+	uint16_t bits_per_sample; //signed integer samples
+};
+
+//Streams the mixer output as raw PCM to stdout ("-"), a FIFO or file path, or a Unix socket ("unix:/path").
+//Write() never blocks the audio thread; a writer thread drains the ring, waiting for slow readers.
+//Samples that do not fit into the ring are dropped and counted. FIFOs and sockets are reopened
+//when the reader goes away, the header is repeated on every new connection.
+class PcmStreamSink
+{
+private:
+	const std::string target;
+	const int sample_freq_Hz;
+	const int channels;
+	bool verbose;
+
+	int fd;
+	bool is_stdout;
+	SpscRing<int16_t> ring;
+	std::atomic<uint64_t> dropped_frames;
+	std::atomic<bool> quit;
+	pthread_t writer_thread;
+
+	PcmStreamSink(const PcmStreamSink& other) = delete;
+	PcmStreamSink& operator=(const PcmStreamSink&) = delete;
+
+	static void *runWriterThread(void *arg);
+	void writerLoop();
+	bool openTarget();
+	void closeTarget();
+	bool writeAll(const void *data, size_t size);
+public:
+	//buffer_ms: ring size, how long a reader may stall before samples are dropped.
+	PcmStreamSink(std::string target, int sample_freq_Hz, int channels = 2, int buffer_ms = 1000, bool verbose = false);
+	~PcmStreamSink();
+
+	//Queues interleaved frames, returns immediately.
+	void Write(const int16_t *samples, size_t frame_count);
+	uint64_t GetDroppedFrames() { return dropped_frames.load(); }
+};
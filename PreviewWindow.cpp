@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <opencv/highgui.h>
+
+#include "PreviewWindow.h"
+#include "AudioData.h"
+
+PreviewWindow::PreviewWindow(std::string window_name, int max_fps, bool show_overlay) :
+	window_name(window_name),
+	max_fps(std::max(max_fps, 1)),
+	show_overlay(show_overlay),
+	new_image(false),
+	quit(false)
+{
+	pthread_mutex_init(&preview_mutex, NULL);
+	pthread_cond_init(&preview_cond, NULL);
+
+	if (pthread_create(&display_thread, NULL, runDisplayThread, this))
+	{
+		throw(std::runtime_error("Error setting up preview thread."));
+	}
+}
+
+PreviewWindow::~PreviewWindow()
+{
+	pthread_mutex_lock(&preview_mutex);
+	quit = true;
+	pthread_cond_signal(&preview_cond);
+	pthread_mutex_unlock(&preview_mutex);
+
+	pthread_join(display_thread, nullptr);
+
+	pthread_cond_destroy(&preview_cond);
+	pthread_mutex_destroy(&preview_mutex);
+}
+
+void *PreviewWindow::runDisplayThread(void *arg)
+{
+	static_cast<PreviewWindow*>(arg)->displayLoop();
+	return nullptr;
+}
+
+void PreviewWindow::SetImage(const cv::Mat &image)
+{
+	pthread_mutex_lock(&preview_mutex);
+	image.copyTo(latest_image);
+	new_image = true;
+	pthread_cond_signal(&preview_cond);
+	pthread_mutex_unlock(&preview_mutex);
+}
+
+void PreviewWindow::SetOverlayText(std::string text)
+{
+	pthread_mutex_lock(&preview_mutex);
+	overlay_text = text;
+	pthread_mutex_unlock(&preview_mutex);
+}
+
+void PreviewWindow::displayLoop()
+{
+	//HighGUI windows belong to the thread that created them:
+	cv::namedWindow(window_name, CV_WINDOW_NORMAL);
+
+	cv::Mat image;
+	cv::Mat canvas;
+	std::string text;
+
+	pthread_mutex_lock(&preview_mutex);
+	while (!quit)
+	{
+		//Without overlay there is nothing to redraw until a new image arrives:
+		while (!new_image && !show_overlay && !quit)
+		{
+			pthread_cond_wait(&preview_cond, &preview_mutex);
+		}
+		if (quit)
+		{
+			break;
+		}
+
+		bool update = new_image || show_overlay;
+		if (new_image)
+		{
+			latest_image.copyTo(image);
+			new_image = false;
+		}
+		text = overlay_text;
+		pthread_mutex_unlock(&preview_mutex);
+
+		if (update && !image.empty())
+		{
+			if (show_overlay)
+			{
+				render(image, text, canvas);
+				cv::imshow(window_name, canvas);
+			}
+			else
+			{
+				cv::imshow(window_name, image);
+			}
+		}
+
+		//Handles window events and limits the frame rate:
+		cv::waitKey(1000 / max_fps);
+
+		pthread_mutex_lock(&preview_mutex);
+	}
+	pthread_mutex_unlock(&preview_mutex);
+
+	cv::destroyWindow(window_name);
+}
+
+void PreviewWindow::render(const cv::Mat &image, const std::string &text, cv::Mat &canvas)
+{
+	//Enlarge without smoothing so the pixels that are played stay visible:
+	int scale = std::max(1, 704 / image.cols);
+	cv::Mat scaled;
+	cv::resize(image, scaled, cv::Size(image.cols * scale, image.rows * scale), 0, 0, cv::INTER_NEAREST);
+	cv::cvtColor(scaled, canvas, CV_GRAY2BGR);
+
+	float progress = AudioData::GetPlayProgress();
+	if (progress >= 0.0)
+	{
+		int x = (int)(progress * image.cols) * scale + scale / 2;
+		cv::line(canvas, cv::Point(x, 0), cv::Point(x, canvas.rows - 1), cv::Scalar(0, 0, 255), 1);
+	}
+
+	std::istringstream lines(text);
+	std::string line;
+	int y = 15;
+	while (std::getline(lines, line))
+	{
+		cv::putText(canvas, line, cv::Point(5, y), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0, 255, 0), 1);
+		y += 15;
+	}
+}
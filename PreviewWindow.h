@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <pthread.h>
+#include <opencv/cv.h>
+
+//Preview window updated on its own display thread, so the worker never waits for the window.
+//Only the latest image is kept, the window is redrawn at most max_fps times per second.
+class PreviewWindow
+{
+private:
+	const std::string window_name;
+	const int max_fps;
+	const bool show_overlay;
+
+	cv::Mat latest_image;
+	bool new_image;
+	std::string overlay_text;
+	bool quit;
+
+	pthread_mutex_t preview_mutex;
+	pthread_cond_t preview_cond;
+	pthread_t display_thread;
+
+	PreviewWindow(const PreviewWindow& other) = delete;
+	PreviewWindow& operator=(const PreviewWindow&) = delete;
+
+	static void *runDisplayThread(void *arg);
+	void displayLoop();
+	void render(const cv::Mat &image, const std::string &text, cv::Mat &canvas);
+public:
+	//show_overlay: draw the overlay text and the column being played.
+	PreviewWindow(std::string window_name, int max_fps = 10, bool show_overlay = false);
+	~PreviewWindow();
+
+	//Copies the image (CV_8UC1, columns in playing order) into the display slot. Returns immediately.
+	void SetImage(const cv::Mat &image);
+	//Lines separated by '\n', e.g. stage timings.
+	void SetOverlayText(std::string text);
+};
@@ -9,10 +9,19 @@
 // License: https://creativecommons.org/licenses/by/4.0/
 
 #include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
 #include "RaspiVoice.h"
 #include "ImageToSoundscape.h"
 #include "test_image.h"
 #include "printtime.h"
+#include "ImageProcessing.h"
+#include "SampleConversion.h"
+
+static const double histogram_smoothing = 0.2; //weight of the newest frame in automatic settings
+static const float max_auto_contrast_gain = 4.0; //limits noise amplification in flat scenes
+static const int first_soundscape_part_columns = 8; //see streamFirstSoundscape
 
 RaspiVoice::RaspiVoice(RaspiVoiceOptions opt) :
 	rows(opt.rows),
@@ -21,24 +30,64 @@ RaspiVoice::RaspiVoice(RaspiVoiceOptions opt) :
 	preview(opt.preview),
 	use_bw_test_image(opt.use_bw_test_image),
 	verbose(opt.verbose),
-	opt(opt)
+	continuous(opt.continuous),
+	opt(opt),
+	converterPool((size_t)opt.converter_cache_mb * 1024 * 1024, 4, opt.verbose, opt.lazy_cache),
+	prepareTime_ms(0),
+	leadTime_ms(0),
+	underruns(0),
+	overruns(0),
+	streamFirstSoundscape(opt.lazy_cache && !opt.continuous),
+	soundscapeQueued(false),
+	sweepImageTaken(false),
+	sweepMuted(opt.mute),
+	sweepQuit(false),
+	sweepRecordPrefix(opt.record_prefix),
+	sweepRecordSegment_s(opt.record_segment_s)
 {
 	if ((image_source == 0) && (opt.input_filename == "")) //Test image, fixed size
 	{
 		rows = 64;
 		columns = 64;
 	}
+
+	//With a lazy cache, its workers build it while the image source is set up:
+	i2ssConverter = converterPool.Get(getSoundscapeParameters(opt), true);
+
 	init();
 
-	i2ssConverter = new ImageToSoundscapeConverter(rows, columns, opt.freq_lowest, opt.freq_highest, opt.sample_freq_Hz, opt.total_time_s, opt.use_exponential, opt.use_stereo, opt.use_delay, opt.use_fade, opt.use_diffraction, opt.use_bspline, opt.speed_of_sound_m_s, opt.acoustical_size_of_head_m);
+	//Sweep pieces are contiguous, only whole soundscapes are crossfaded:
+	AudioData::SetCrossfade(continuous ? 0 : opt.crossfade_ms);
+
+	pthread_mutex_init(&sweepMutex, NULL);
+	pthread_cond_init(&sweepCond, NULL);
+	if (continuous)
+	{
+		if (!opt.use_stereo)
+		{
+			throw(std::runtime_error("Continuous sweep needs stereo audio."));
+		}
+
+		publishSweepImage();
+		if (pthread_create(&sweepThread, NULL, runSweepThread, this))
+		{
+			throw(std::runtime_error("Error setting up sweep thread."));
+		}
+	}
 }
 
 RaspiVoice::~RaspiVoice()
 {
-	if (i2ssConverter)
+	if (continuous)
 	{
-		delete(i2ssConverter);
+		pthread_mutex_lock(&sweepMutex);
+		sweepQuit = true;
+		pthread_cond_broadcast(&sweepCond);
+		pthread_mutex_unlock(&sweepMutex);
+		pthread_join(sweepThread, nullptr);
 	}
+	pthread_cond_destroy(&sweepCond);
+	pthread_mutex_destroy(&sweepMutex);
 
 	if (image_source == 1)
 	{
@@ -57,6 +106,12 @@ void RaspiVoice::init()
 
 	image = new std::vector<float>(rows*columns);
 
+	BuildAmplitudeLut(amplitudeLut);
+	for (int v = 0; v < 256; v++)
+	{
+		identityLut[v] = v;
+	}
+
 	if (image_source == 0) //Test image
 	{
 		if (opt.input_filename == "")
@@ -77,15 +132,20 @@ void RaspiVoice::init()
 	{
 		initUsbCam();
 	}
+	else if (image_source == -1) //Shared memory frames
+	{
+		sharedFrameSource.Open(opt.shared_memory_name, verbose);
+	}
 
 	if (preview)
 	{
-		cv::namedWindow("RaspiVoice Preview", CV_WINDOW_NORMAL);
+		previewWindow.reset(new PreviewWindow("RaspiVoice Preview", opt.preview_fps, opt.preview_overlay));
 	}
 
 	//Test read + process one image:
-	cv::Mat im = readImage();
-	processImage(im);
+	readAndScaleImage();
+	processImage();
+	v4l2Capture.Release();
 }
 
 void RaspiVoice::initTestImage()
@@ -149,6 +209,45 @@ void RaspiVoice::initFileImage()
 }
 
 
+cv::Size RaspiVoice::getCaptureSize()
+{
+	//Smallest 4:3 capture with at least one camera pixel per soundscape pixel in the zoomed region:
+	float zoom = std::max(opt.zoom, 1.0f);
+	int width = std::max(columns * zoom, rows * zoom * 4 / 3);
+	if (opt.foveal_mapping)
+	{
+		width = std::max(width, 320); //Undistortion is tuned for 320x240
+	}
+	width = std::min(((width + 31) / 32) * 32, 1280); //RaspiCam needs multiples of 32x16
+	int height = ((width * 3 / 4 + 15) / 16) * 16;
+
+	return cv::Size(width, height);
+}
+
+void RaspiVoice::updateCaptureSize()
+{
+	cv::Size size = getCaptureSize();
+	if ((image_source < 1) || ((size.width == captureSize.width) && (size.height == captureSize.height)))
+	{
+		return;
+	}
+
+	if (verbose)
+	{
+		std::cout << "Changing capture size to " << size.width << "x" << size.height << std::endl;
+	}
+
+	if (image_source == 1)
+	{
+		raspiCam.release();
+		initRaspiCam();
+	}
+	else
+	{
+		initUsbCam();
+	}
+}
+
 void RaspiVoice::initRaspiCam()
 {
 	if (verbose)
@@ -156,15 +255,27 @@ void RaspiVoice::initRaspiCam()
 		std::cout << "Opening RaspiCam..." << std::endl;
 	}
 
+	captureSize = getCaptureSize();
+
 	raspiCam.set(CV_CAP_PROP_FORMAT, CV_8UC1);
-	raspiCam.set(CV_CAP_PROP_FRAME_WIDTH, 320); //Somehow, other resolutions did not work
-	raspiCam.set(CV_CAP_PROP_FRAME_HEIGHT, 240);
+	raspiCam.set(CV_CAP_PROP_FRAME_WIDTH, captureSize.width);
+	raspiCam.set(CV_CAP_PROP_FRAME_HEIGHT, captureSize.height);
 	if ((opt.exposure >= 1) && (opt.exposure <= 100))
 	{
 		raspiCam.set(CV_CAP_PROP_EXPOSURE, opt.exposure);
 	}
-	
-	if (!raspiCam.open())
+
+	bool ok = raspiCam.open();
+	if (!ok && ((captureSize.width != 320) || (captureSize.height != 240)))
+	{
+		//Fall back to the size that is known to work:
+		captureSize = cv::Size(320, 240);
+		raspiCam.set(CV_CAP_PROP_FRAME_WIDTH, captureSize.width);
+		raspiCam.set(CV_CAP_PROP_FRAME_HEIGHT, captureSize.height);
+		ok = raspiCam.open();
+	}
+
+	if (!ok)
 	{
 		throw(std::runtime_error("Error opening RaspiCam."));
 	}
@@ -172,7 +283,7 @@ void RaspiVoice::initRaspiCam()
 	{
 		if (verbose)
 		{
-			std::cout << "Ok" << std::endl;
+			std::cout << "Ok, " << captureSize.width << "x" << captureSize.height << std::endl;
 		}
 	}
 }
@@ -186,19 +297,29 @@ void RaspiVoice::initUsbCam()
 		std::cout << "Opening USB camera..." << std::endl;
 	}
 
-	cap.open(cam_id);
+	captureSize = getCaptureSize();
+
+	if (opt.use_v4l2)
+	{
+		//The driver picks the nearest supported (possibly hardware scaled) size:
+		v4l2Capture.Open(cam_id, captureSize.width, captureSize.height, opt.exposure, verbose);
+		return;
+	}
 
 	if (!cap.isOpened())
 	{
-		throw(std::runtime_error("Could not open camera."));
+		cap.open(cam_id);
+
+		if (!cap.isOpened())
+		{
+			throw(std::runtime_error("Could not open camera."));
+		}
+		// Setting standard capture size, may fail; resize later
+		cv::Mat rawImage;
+		cap.read(rawImage);  // Dummy read needed with some devices
 	}
-	// Setting standard capture size, may fail; resize later
-	cv::Mat rawImage;
-	cap.read(rawImage);  // Dummy read needed with some devices
-	//cap.set(CV_CAP_PROP_FRAME_WIDTH, 176);
-	//cap.set(CV_CAP_PROP_FRAME_HEIGHT, 144);
-	cap.set(CV_CAP_PROP_FRAME_WIDTH, 320); //Increased resolution necessary for foveal mapping
-	cap.set(CV_CAP_PROP_FRAME_HEIGHT, 240);
+	cap.set(CV_CAP_PROP_FRAME_WIDTH, captureSize.width);
+	cap.set(CV_CAP_PROP_FRAME_HEIGHT, captureSize.height);
 	if ((opt.exposure >= 1) && (opt.exposure <= 100))
 	{
 		cap.set(CV_CAP_PROP_EXPOSURE, opt.exposure);
@@ -210,15 +331,11 @@ void RaspiVoice::initUsbCam()
 	}
 }
 
-cv::Mat RaspiVoice::readImage()
+cv::Mat RaspiVoice::readImage(bool retrieve)
 {
 	cv::Mat rawImage;
 	cv::Mat processedImage;
 
-	if (verbose)
-	{
-		printtime("ReadImage start");
-	}
 	if ((image_source == 0) && (opt.input_filename != ""))
 	{
 		rawImage = cv::imread(opt.input_filename.c_str(), CV_LOAD_IMAGE_GRAYSCALE);
@@ -227,29 +344,32 @@ cv::Mat RaspiVoice::readImage()
 	else if (image_source == 1) //RaspiCAM
 	{
 		raspiCam.grab();
-		raspiCam.retrieve(rawImage);
-		if (opt.read_frames > 1)
+		if (retrieve)
 		{
-			for (int r = 1; r < opt.read_frames; r++)
-			{
-				raspiCam.grab();
-				raspiCam.retrieve(rawImage);
-			}
+			raspiCam.retrieve(rawImage);
 		}
 		//cv::imwrite("/var/tmp/raspicam_frame.jpg", processedImage);
 		processedImage = rawImage;
 	}
+	else if (image_source == -1) //Shared memory, read in place
+	{
+		rawImage = sharedFrameSource.Grab();
+		processedImage = rawImage;
+	}
+	else if ((image_source >= 2) && v4l2Capture.IsOpen()) //V4L2 camera, GREY or YUYV without copy
+	{
+		rawImage = v4l2Capture.Grab();
+		processedImage = rawImage;
+	}
 	else if (image_source >= 2) //OpenCv camera
 	{
-		cap.read(rawImage);
-		if (opt.read_frames > 1)
+		if (!retrieve)
 		{
-			for (int r = 1; r < opt.read_frames; r++)
-			{
-				cap.read(rawImage);
-			}
+			cap.grab();
+			return processedImage;
 		}
 
+		cap.read(rawImage);
 		if (rawImage.empty())
 		{
 			throw(std::runtime_error("Error reading frame from camera."));
@@ -261,153 +381,305 @@ cv::Mat RaspiVoice::readImage()
 	return processedImage;
 }
 
-
-void RaspiVoice::processImage(cv::Mat rawImage)
+void RaspiVoice::readAndScaleImage()
 {
-	cv::Mat processedImage = rawImage;
+	if ((image_source == 0) && (opt.input_filename == "")) //Test image
+	{
+		return;
+	}
 
 	if (verbose)
 	{
-		printtime("ProcessImage start");
+		printtime("ReadImage start");
 	}
 
-	if ((image_source > 0) || (opt.input_filename != ""))
+	//Cameras are read read_frames times to get past buffered frames, files and shared memory once:
+	int frames = (image_source > 0) ? std::max(opt.read_frames, 1) : 1;
+	bool accumulate = (opt.frame_averaging == 1) && (frames > 1);
+
+	for (int r = 0; r < frames; r++)
 	{
-		if (opt.foveal_mapping)
+		bool last = (r == frames - 1);
+		cv::Mat im = readImage(accumulate || last);
+		if (accumulate || last)
 		{
-			cv::Matx33f cameraMatrix(100, 0, processedImage.cols / 2, 0, 100, processedImage.rows / 2, 0, 0, 1);
-			cv::Matx41f distCoeffs(5.0, 5.0, 0, 0);
-			cv::Mat processedImage2;
-			cv::undistort(processedImage, processedImage2, cameraMatrix, distCoeffs);
-			float clipzoom = 1.8; //horizontal zoom to remove blinders, decreases resolution if > 1.0
-			cv::Rect roi(processedImage.cols / 2 - columns / 2 / clipzoom, processedImage.rows / 2 - rows / 2, columns / clipzoom, rows);
-			processedImage = processedImage2(roi);
-		}
+			scaleImage(im);
 
-		if (opt.zoom > 1.0)
-		{
-			int w = processedImage.cols;
-			int h = processedImage.rows;
-			float z = opt.zoom;
-			cv::Rect roi((w / 2.0) - w / (2.0*z), (h / 2.0) - h / (2.0*z), w/z, h/z);
-			processedImage = processedImage(roi);
+			//Shared memory frames are read in place, again if the producer has reused the slot meanwhile:
+			while ((image_source == -1) && !sharedFrameSource.IsUnchanged())
+			{
+				scaleImage(readImage(true));
+			}
 		}
-
-		//Bring to size needed by ImageToSoundscape:
-		if (processedImage.rows != rows || processedImage.cols != columns)
+		if (accumulate)
 		{
-			cv::resize(processedImage, processedImage, cv::Size(columns, rows));
+			accumulateFrame(r == 0, last ? frames : 0);
 		}
+	}
+
+	if (opt.frame_averaging == 2)
+	{
+		averageFrame();
+	}
+	else
+	{
+		frameAverage.clear();
+	}
+}
+
+//Sums the frames read for one soundscape at target size, divides by frame_count when given.
+void RaspiVoice::accumulateFrame(bool first, int frame_count)
+{
+	if (first)
+	{
+		frameSum.assign(rows * columns, 0);
+	}
 
-		if ((opt.blinders > 0) && (opt.blinders < columns/2))
+	for (int y = 0; y < rows; y++)
+	{
+		uchar *p = smallImage.ptr<uchar>(y);
+		uint32_t *sum = &frameSum[y * columns];
+		for (int x = 0; x < columns; x++)
 		{
-			processedImage(cv::Rect(0, 0, opt.blinders, rows - 1)).setTo(0);
-			processedImage(cv::Rect(columns - 1 - opt.blinders, 0, opt.blinders, rows - 1)).setTo(0);
+			sum[x] += p[x];
 		}
 
-		if ((opt.contrast != 1.0) || (opt.brightness != 0))
+		if (frame_count > 0)
 		{
-			float alpha = opt.contrast;
-			int beta = opt.brightness;
-
-			for (int y = 0; y < processedImage.rows; y++)
+			for (int x = 0; x < columns; x++)
 			{
-				for (int x = 0; x < processedImage.cols; x++)
-				{
-					processedImage.at<uchar>(y, x) = cv::saturate_cast<uchar>(alpha*(processedImage.at<uchar>(y, x)) + beta);
-				}
+				p[x] = (uchar)((sum[x] + frame_count / 2) / frame_count);
 			}
 		}
+	}
+}
+
+//Exponential moving average over soundscapes at target size, in 1/256 steps.
+void RaspiVoice::averageFrame()
+{
+	int weight = std::min(std::max((int)(opt.averaging_weight * 256.0f + 0.5f), 1), 256);
+	bool reset = (frameAverage.size() != (size_t)(rows * columns));
+	if (reset)
+	{
+		frameAverage.resize(rows * columns);
+	}
 
-		if (opt.threshold > 0)
+	for (int y = 0; y < rows; y++)
+	{
+		uchar *p = smallImage.ptr<uchar>(y);
+		int32_t *average = &frameAverage[y * columns];
+		for (int x = 0; x < columns; x++)
 		{
-			if (opt.threshold < 255)
+			int32_t target = p[x] << 8;
+			if (reset)
 			{
-				cv::threshold(processedImage, processedImage, opt.threshold, 255, cv::THRESH_BINARY);
+				average[x] = target;
 			}
 			else
 			{
-				//Auto threshold:
-				cv::threshold(processedImage, processedImage, 127, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+				average[x] += ((target - average[x]) * weight) >> 8;
 			}
+			p[x] = (uchar)((average[x] + 128) >> 8);
 		}
+	}
+}
+
+//Brings a camera or file image to the size needed by ImageToSoundscape, in smallImage.
+void RaspiVoice::scaleImage(cv::Mat rawImage)
+{
+	cv::Mat processedImage = rawImage;
+
+	//YUYV from V4L2: luma is channel 0, only extracted here if the full frame is needed
+	if ((processedImage.channels() == 2) && opt.foveal_mapping)
+	{
+		cv::Mat luma;
+		cv::extractChannel(processedImage, luma, 0);
+		processedImage = luma;
+	}
 
-		if (opt.negative_image)
+	if (opt.foveal_mapping)
+	{
+		cv::Matx33f cameraMatrix(100, 0, processedImage.cols / 2, 0, 100, processedImage.rows / 2, 0, 0, 1);
+		cv::Matx41f distCoeffs(5.0, 5.0, 0, 0);
+		cv::Mat processedImage2;
+		cv::undistort(processedImage, processedImage2, cameraMatrix, distCoeffs);
+		float clipzoom = 1.8; //horizontal zoom to remove blinders, decreases resolution if > 1.0
+		cv::Rect roi(processedImage.cols / 2 - columns / 2 / clipzoom, processedImage.rows / 2 - rows / 2, columns / clipzoom, rows);
+		processedImage = processedImage2(roi);
+	}
+
+	if (opt.zoom > 1.0)
+	{
+		int w = processedImage.cols;
+		int h = processedImage.rows;
+		float z = opt.zoom;
+		cv::Rect roi((w / 2.0) - w / (2.0*z), (h / 2.0) - h / (2.0*z), w/z, h/z);
+		processedImage = processedImage(roi);
+	}
+
+	//Bring to size needed by ImageToSoundscape, in one area-averaging pass.
+	//Blinded columns are not sampled, YUYV luma is read in place.
+	int first_column = 0;
+	int last_column = columns;
+	if ((opt.blinders > 0) && (opt.blinders < columns / 2))
+	{
+		first_column = opt.blinders;
+		last_column = columns - opt.blinders;
+	}
+	smallImage.create(rows, columns, CV_8UC1);
+	AreaDownscale(processedImage, smallImage, first_column, last_column);
+}
+
+void RaspiVoice::processImage()
+{
+	cv::Mat processedImage = smallImage;
+
+	if (verbose)
+	{
+		printtime("ProcessImage start");
+	}
+
+	if ((image_source != 0) || (opt.input_filename != ""))
+	{
+		int first_column = 0;
+		int last_column = columns;
+		if ((opt.blinders > 0) && (opt.blinders < columns / 2))
 		{
-			cv::Mat sub_mat = cv::Mat::ones(processedImage.size(), processedImage.type()) * 255;
-			cv::subtract(sub_mat, processedImage, processedImage);
+			first_column = opt.blinders;
+			last_column = columns - opt.blinders;
 		}
 
-		if (opt.edge_detection_opacity > 0.0)
+		//Automatic settings use the histogram of previous frames, collected by the mapping pass below:
+		bool use_histogram = (opt.threshold >= 255) || (opt.auto_contrast > 0.0);
+		uint32_t histogram[256];
+		if (!use_histogram)
 		{
-			cv::Mat blurImage;
-			cv::Mat edgesImage;
-			int ratio = 3;
-			int kernel_size = 3;
-			int lowThreshold = opt.edge_detection_threshold;
-			if (lowThreshold <= 0)
-			{
-				lowThreshold = 127;
-			}
-			cv::blur(processedImage, blurImage, cv::Size(3, 3));
-			cv::Canny(blurImage, edgesImage, lowThreshold, lowThreshold*ratio, kernel_size);
+			smoothedHistogram.Reset();
+		}
+		else if (!smoothedHistogram.IsValid())
+		{
+			ComputeHistogram(smallImage, first_column, last_column, histogram);
+			smoothedHistogram.Update(histogram, 1.0);
+		}
 
-			double alpha = opt.edge_detection_opacity;
-			if (alpha > 1.0)
-			{
-				alpha = 1.0;
-			}
-			double beta = (1.0 - alpha);
-			cv::addWeighted(edgesImage, alpha, processedImage, beta, 0.0, processedImage);
+		float contrast = opt.contrast;
+		float brightness = opt.brightness;
+		if (opt.auto_contrast > 0.0)
+		{
+			//Stretch the range between the percentiles to 0-255, user contrast and brightness apply on top:
+			double clip = std::min(opt.auto_contrast, 49.0f) / 100.0;
+			int low = smoothedHistogram.Percentile(clip);
+			int high = smoothedHistogram.Percentile(1.0 - clip);
+			float gain = std::min(255.0f / std::max(high - low, 1), max_auto_contrast_gain);
+			float offset = 127.5f - gain * (low + high) / 2.0f;
+			contrast = opt.contrast * gain;
+			brightness = opt.contrast * offset + opt.brightness;
 		}
 
-		if ((opt.flip >= 1) && (opt.flip <= 3))
+		//Contrast/brightness, threshold and negative as one lookup table:
+		BuildPointLut(contrast, brightness, opt.threshold, opt.negative_image, smoothedHistogram.Data(), pointLut);
+
+		int blinders = first_column;
+		const uchar *lut = pointLut;
+		if (opt.edge_detection_opacity > 0.0)
 		{
-			int flipCode;
-			if (opt.flip == 1) //h
+			//Edge detection needs the point-processed image:
+			cv::LUT(smallImage, cv::Mat(1, 256, CV_8UC1, pointLut), pointImage);
+			if (blinders > 0)
 			{
-				flipCode = 1;
+				pointImage(cv::Rect(0, 0, blinders, rows)).setTo(pointLut[0]);
+				pointImage(cv::Rect(columns - blinders, 0, blinders, rows)).setTo(pointLut[0]);
 			}
-			else if (opt.flip == 2) //v
-			{
-				flipCode = 0;
-			}
-			else if (opt.flip == 3) //h+v
+
+			EdgeDetector::Mode mode = (opt.edge_detection_mode == 1) ? EdgeDetector::Mode::Fast : EdgeDetector::Mode::Canny;
+			edgeDetector.Apply(pointImage, edgesImage, mode, opt.edge_detection_threshold, opt.edge_detection_opacity);
+
+			if (use_histogram)
 			{
-				flipCode = -1;
+				ComputeHistogram(smallImage, first_column, last_column, histogram);
+				use_histogram = false;
+				smoothedHistogram.Update(histogram, histogram_smoothing);
 			}
 
-			cv::flip(processedImage, processedImage, flipCode);
+			processedImage = edgesImage;
+			blinders = 0;
+			lut = identityLut;
+		}
+
+		//Flip, blinders and the mapping to amplitudes in one pass:
+		int flip = ((opt.flip >= 1) && (opt.flip <= 3)) ? opt.flip : 0;
+		MapToSoundscapeImage(processedImage, lut, amplitudeLut, flip, blinders, *image, preview ? &previewImage : nullptr, use_histogram ? histogram : nullptr);
+		if (use_histogram)
+		{
+			smoothedHistogram.Update(histogram, histogram_smoothing);
 		}
 
 		if (preview)
 		{
 			//Screen views
 			//imwrite("raspivoice_capture_raw.jpg", rawImage);
-			//imwrite("raspivoice_capture_scaled_gray.jpg", processedImage);
-			cv::imshow("RaspiVoice Preview", processedImage);
-
-			cv::waitKey(200);
+			//imwrite("raspivoice_capture_scaled_gray.jpg", previewImage);
+			previewWindow->SetImage(previewImage);
 		}
+	}
 
-		/* Set live camera image */
-		for (int j = 0; j < columns; j++)
-		{
-			for (int i = 0; i < rows; i++)
-			{
-				int mVal = processedImage.at<uchar>(rows - 1 - i, j) / 16;
-				if (mVal == 0)
-				{
-					(*image)[IDX2D(i, j)] = 0;
-				}
-				else
-				{
-					(*image)[IDX2D(i, j)] = pow(10.0, (mVal - 15) / 10.0);   // 2dB steps
-				}
-			}
-		}
+}
+
+SoundscapeParameters RaspiVoice::getSoundscapeParameters(const RaspiVoiceOptions &opt)
+{
+	SoundscapeParameters params;
+
+	params.rows = opt.rows;
+	params.columns = opt.columns;
+	if ((image_source == 0) && (opt.input_filename == "")) //Test image, fixed size
+	{
+		params.rows = rows;
+		params.columns = columns;
+	}
+	params.freq_lowest = opt.freq_lowest;
+	params.freq_highest = opt.freq_highest;
+	params.sample_freq_Hz = opt.sample_freq_Hz;
+	params.total_time_s = opt.total_time_s;
+	params.use_exponential = opt.use_exponential;
+	params.use_stereo = opt.use_stereo;
+	params.use_delay = opt.use_delay;
+	params.use_fade = opt.use_fade;
+	params.use_diffraction = opt.use_diffraction;
+	params.use_bspline = opt.use_bspline;
+	params.speed_of_sound_m_s = opt.speed_of_sound_m_s;
+	params.acoustical_size_of_head_m = opt.acoustical_size_of_head_m;
+	params.engine = (SynthesisEngine)opt.synthesis_engine;
+
+	return params;
+}
+
+void RaspiVoice::updateConverter()
+{
+	SoundscapeParameters params = getSoundscapeParameters(opt);
+	if (params == i2ssConverter->GetParameters())
+	{
+		return;
+	}
+
+	//Keep playing with the current converter until the new one has been built in the background:
+	std::shared_ptr<ImageToSoundscapeConverter> converter = converterPool.Get(params, false);
+	if (!converter)
+	{
+		return;
+	}
+
+	if (verbose)
+	{
+		printtime("Switching converter");
 	}
 
+	i2ssConverter = converter;
+	if ((rows != params.rows) || (columns != params.columns))
+	{
+		rows = params.rows;
+		columns = params.columns;
+		image->resize(rows * columns);
+	}
 }
 
 void RaspiVoice::GrabAndProcessFrame(RaspiVoiceOptions opt)
@@ -415,15 +687,86 @@ void RaspiVoice::GrabAndProcessFrame(RaspiVoiceOptions opt)
 	//Set new options. Options that have been copied to RaspiVoice:: fields in constructor are unaffected.
 	this->opt = opt;
 
+	//Switch synthesis parameters at frame boundary:
+	StageTimer timer;
+	updateConverter();
+	updateCaptureSize();
+
 	//Read and process images:
-	cv::Mat im = readImage();
-	processImage(im);
+	readAndScaleImage();
+	double read_ms = timer.Lap();
+	processImage();
+	double process_ms = timer.Lap();
 
-	if (verbose)
+	//Camera buffer is not needed anymore after preprocessing:
+	v4l2Capture.Release();
+
+	if (continuous)
+	{
+		//Synthesized column by column on the sweep thread:
+		publishSweepImage();
+	}
+	else
+	{
+		if (verbose)
+		{
+			printtime("vOICe algorithm process start");
+		}
+
+		//The buffer follows the format of the converter:
+		if (!audioData || (audioData->GetFrameCount() != i2ssConverter->GetFrameCount()) ||
+			(audioData->GetSampleFreq() != i2ssConverter->GetSampleFreq()) || (audioData->GetChannels() != i2ssConverter->GetChannels()))
+		{
+			audioData.reset(new AudioData(opt.audio_card, i2ssConverter->GetSampleFreq(), i2ssConverter->GetFrameCount(), i2ssConverter->GetChannels() == 2));
+		}
+		//The output filter runs on from the previous frame, unless the converter changed:
+		if (frameStateConverter != i2ssConverter)
+		{
+			frameState = SynthesisState();
+			frameStateConverter = i2ssConverter;
+		}
+		soundscapeQueued = false;
+		if (streamFirstSoundscape && !opt.mute && (i2ssConverter->GetChannels() == 2))
+		{
+			//The cache is still being built: queue the first soundscape in parts as they are rendered, so it
+			//starts after the first part instead of the whole build:
+			int converter_columns = i2ssConverter->GetColumns();
+			for (int column = 0; column < converter_columns; column += first_soundscape_part_columns)
+			{
+				int column_count = std::min(first_soundscape_part_columns, converter_columns - column);
+				uint32_t first_frame = i2ssConverter->GetColumnStartSample(column);
+				uint32_t end_frame = i2ssConverter->GetColumnStartSample(column + column_count);
+				i2ssConverter->ProcessColumns(image->data(), column, column_count, frameState, &audioData->Data()[2 * first_frame]);
+				audioData->PlayPart(first_frame, end_frame - first_frame);
+			}
+			soundscapeQueued = true;
+		}
+		else
+		{
+			i2ssConverter->Process(image->data(), frameState, audioData->Data());
+		}
+		streamFirstSoundscape = false;
+	}
+	double synthesis_ms = timer.Lap();
+	//A soundscape queued in parts was rendered while it played:
+	prepareTime_ms = read_ms + process_ms + (soundscapeQueued ? 0.0 : synthesis_ms);
+
+	if (previewWindow)
 	{
-		printtime("vOICe algorithm process start");
+		std::stringstream timings;
+		timings << std::fixed << std::setprecision(1);
+		timings << "read " << read_ms << " ms\n";
+		timings << "process " << process_ms << " ms\n";
+		timings << "synthesis " << synthesis_ms << " ms\n";
+		double resample_ms = AudioData::GetResampleTime_ms();
+		if (resample_ms > 0.0)
+		{
+			timings << "resample " << resample_ms << " ms\n";
+		}
+		timings << "underruns " << AudioData::GetUnderruns() << ", overruns " << AudioData::GetOverruns() << "\n";
+		timings << "frame " << frameTimer.Lap() << " ms";
+		previewWindow->SetOverlayText(timings.str());
 	}
-	i2ssConverter->Process(*image);
 }
 
 void RaspiVoice::PlayFrame(RaspiVoiceOptions opt)
@@ -433,9 +776,25 @@ void RaspiVoice::PlayFrame(RaspiVoiceOptions opt)
 		return;
 	}
 
+	if (continuous)
+	{
+		//Hand the settings to the sweep thread, the next frame is grabbed once it has taken this one:
+		pthread_mutex_lock(&sweepMutex);
+		sweepMuted = opt.mute;
+		sweepRecordPrefix = opt.record_prefix;
+		sweepRecordSegment_s = opt.record_segment_s;
+		pthread_cond_broadcast(&sweepCond);
+		while (!sweepImageTaken && !sweepMuted && !sweepQuit)
+		{
+			pthread_cond_wait(&sweepCond, &sweepMutex);
+		}
+		pthread_mutex_unlock(&sweepMutex);
+		return;
+	}
+
 	if (!opt.mute)
 	{
-		AudioData &audioData = i2ssConverter->GetAudioData();
+		AudioData &audioData = *this->audioData;
 		audioData.CardNumber = opt.audio_card;
 		audioData.Verbose = verbose;
 
@@ -444,7 +803,32 @@ void RaspiVoice::PlayFrame(RaspiVoiceOptions opt)
 			printtime("Playing audio");
 		}
 
-		audioData.Play();
+		if (opt.record_prefix != "")
+		{
+			recordAudio(audioData.Data(), audioData.GetFrameCount(), audioData.GetSampleFreq(), audioData.GetChannels(), opt.record_prefix, opt.record_segment_s);
+		}
+
+		//Overlap the next frame with the end of this one, with some margin for a slower frame. The lead follows
+		//slow frames at once and fast ones slowly, so the latency stays steady. The next frame must be queued
+		//before the crossfade starts:
+		double lead_ms = 1.5 * prepareTime_ms + 20.0 + opt.crossfade_ms;
+		leadTime_ms = std::max(lead_ms, 0.95 * leadTime_ms + 0.05 * lead_ms);
+		int lead_frames = (int)(leadTime_ms * 0.001 * audioData.GetSampleFreq());
+		if (soundscapeQueued)
+		{
+			audioData.WaitUntilPlayed(std::min(lead_frames, audioData.GetFrameCount()));
+		}
+		else
+		{
+			audioData.Play(std::min(lead_frames, audioData.GetFrameCount()));
+		}
+
+		if (verbose && ((AudioData::GetUnderruns() != underruns) || (AudioData::GetOverruns() != overruns)))
+		{
+			underruns = AudioData::GetUnderruns();
+			overruns = AudioData::GetOverruns();
+			std::cout << "Audio underruns: " << underruns << ", overruns: " << overruns << std::endl;
+		}
 
 		if (opt.output_filename != "")
 		{
@@ -459,4 +843,100 @@ void RaspiVoice::PlayFrame(RaspiVoiceOptions opt)
 	}
 }
 
+void RaspiVoice::recordAudio(const float *samples, int frame_count, int sample_freq_Hz, int channels, std::string prefix, int segment_s)
+{
+	//Recordings stay 16-bit:
+	recordBuffer.resize(frame_count * channels);
+	FloatToS16(samples, recordBuffer.data(), recordBuffer.size());
 
+	//Format changes start a new recorder, the old one finishes its file first:
+	if (!sessionRecorder || (sessionRecorder->GetSampleFreq() != sample_freq_Hz) || (sessionRecorder->GetChannels() != channels))
+	{
+		sessionRecorder.reset();
+		sessionRecorder.reset(new SessionRecorder(prefix, sample_freq_Hz, channels, segment_s, 10, verbose));
+	}
+	sessionRecorder->Record(recordBuffer.data(), frame_count);
+}
+
+//Snapshot of the soundscape image for the sweep thread, together with the converter it was made for.
+void RaspiVoice::publishSweepImage()
+{
+	std::shared_ptr<const std::vector<float>> snapshot(new std::vector<float>(*image));
+
+	pthread_mutex_lock(&sweepMutex);
+	sweepConverter = i2ssConverter;
+	sweepImage = snapshot;
+	sweepImageTaken = false;
+	pthread_mutex_unlock(&sweepMutex);
+}
+
+void *RaspiVoice::runSweepThread(void *arg)
+{
+	RaspiVoice *raspiVoice = static_cast<RaspiVoice*>(arg);
+	try
+	{
+		raspiVoice->sweepLoop();
+	}
+	catch (const std::runtime_error &err)
+	{
+		std::cerr << err.what() << std::endl;
+		pthread_mutex_lock(&raspiVoice->sweepMutex);
+		raspiVoice->sweepQuit = true;
+		pthread_cond_broadcast(&raspiVoice->sweepCond);
+		pthread_mutex_unlock(&raspiVoice->sweepMutex);
+	}
+	AudioData::SetSweepProgress(-1.0);
+	return nullptr;
+}
+
+//Continuous sweep: every column is synthesized from the newest image just before the mixer needs it.
+//Oscillator phases and the output filter run on across columns and sweeps, so there are no boundaries to click at.
+void RaspiVoice::sweepLoop()
+{
+	std::shared_ptr<ImageToSoundscapeConverter> converter;
+	std::shared_ptr<const std::vector<float>> sweep_image;
+	SynthesisState state;
+	std::vector<float> samples;
+	int column = 0;
+
+	while (true)
+	{
+		pthread_mutex_lock(&sweepMutex);
+		while (sweepMuted && !sweepQuit)
+		{
+			AudioData::SetSweepProgress(-1.0);
+			pthread_cond_wait(&sweepCond, &sweepMutex);
+		}
+		if (sweepQuit)
+		{
+			pthread_mutex_unlock(&sweepMutex);
+			break;
+		}
+
+		//Parameter changes take effect at the start of a sweep, until then images of the current converter are used:
+		if ((column == 0) || (sweepConverter == converter))
+		{
+			converter = sweepConverter;
+			sweep_image = sweepImage;
+			sweepImageTaken = true;
+			pthread_cond_broadcast(&sweepCond);
+		}
+		std::string record_prefix = sweepRecordPrefix;
+		int record_segment_s = sweepRecordSegment_s;
+		pthread_mutex_unlock(&sweepMutex);
+
+		int frame_count = converter->GetColumnStartSample(column + 1) - converter->GetColumnStartSample(column);
+		samples.resize(2 * frame_count);
+		converter->ProcessColumns(sweep_image->data(), column, 1, state, samples.data());
+
+		if (record_prefix != "")
+		{
+			recordAudio(samples.data(), frame_count, converter->GetSampleFreq(), 2, record_prefix, record_segment_s);
+		}
+
+		AudioData::QueueSoundscape(samples.data(), frame_count, converter->GetSampleFreq(), 2);
+		AudioData::SetSweepProgress((float)column / converter->GetColumns());
+
+		column = (column + 1) % converter->GetColumns();
+	}
+}
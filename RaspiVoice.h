@@ -1,12 +1,22 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <pthread.h>
 #include <raspicam/raspicam_cv.h>
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 
 #include "Options.h"
 #include "ImageToSoundscape.h"
+#include "AudioData.h"
+#include "ConverterPool.h"
+#include "V4l2Capture.h"
+#include "SharedFrameSource.h"
+#include "ImageProcessing.h"
+#include "PreviewWindow.h"
+#include "SessionRecorder.h"
+#include "printtime.h"
 
 class RaspiVoice
 {
@@ -17,12 +27,53 @@ private:
 	bool preview;
 	bool use_bw_test_image;
 	bool verbose;
+	bool continuous;
 	RaspiVoiceOptions opt;
 
-	ImageToSoundscapeConverter *i2ssConverter;
+	ConverterPool converterPool;
+	std::shared_ptr<ImageToSoundscapeConverter> i2ssConverter;
+	std::unique_ptr<AudioData> audioData; //soundscape of the current frame
+	double prepareTime_ms; //grab, process and synthesis of the last frame
+	double leadTime_ms; //how long before the end of a soundscape the next one is prepared
+	uint64_t underruns;
+	uint64_t overruns;
+	SynthesisState frameState; //output filter, carried from frame to frame
+	std::shared_ptr<ImageToSoundscapeConverter> frameStateConverter;
+	bool streamFirstSoundscape; //lazy cache: the first soundscape is played while it is rendered
+	bool soundscapeQueued; //by GrabAndProcessFrame(), in parts
 	raspicam::RaspiCam_Cv raspiCam;
 	cv::VideoCapture cap;
+	V4l2Capture v4l2Capture;
+	SharedFrameSource sharedFrameSource;
 	std::vector<float> *image;
+	cv::Size captureSize;
+	cv::Mat smallImage;
+	std::vector<uint32_t> frameSum;
+	std::vector<int32_t> frameAverage;
+	cv::Mat pointImage;
+	cv::Mat edgesImage;
+	EdgeDetector edgeDetector;
+	SmoothedHistogram smoothedHistogram;
+	cv::Mat previewImage;
+	std::unique_ptr<PreviewWindow> previewWindow;
+	StageTimer frameTimer;
+	std::unique_ptr<SessionRecorder> sessionRecorder;
+	std::vector<int16_t> recordBuffer;
+	uchar pointLut[256];
+	uchar identityLut[256];
+	float amplitudeLut[256];
+
+	//Continuous sweep, see sweepLoop():
+	pthread_t sweepThread;
+	pthread_mutex_t sweepMutex;
+	pthread_cond_t sweepCond;
+	std::shared_ptr<ImageToSoundscapeConverter> sweepConverter;
+	std::shared_ptr<const std::vector<float>> sweepImage;
+	bool sweepImageTaken;
+	bool sweepMuted;
+	bool sweepQuit;
+	std::string sweepRecordPrefix;
+	int sweepRecordSegment_s;
 
 	RaspiVoice(const RaspiVoice& other) = delete;
 	RaspiVoice& operator=(const RaspiVoice&) = delete;
@@ -32,9 +83,21 @@ private:
 	void initTestImage();
 	void initRaspiCam();
 	void initUsbCam();
-	cv::Mat readImage();
-	void processImage(cv::Mat rawImage);
+	cv::Size getCaptureSize();
+	void updateCaptureSize();
+	SoundscapeParameters getSoundscapeParameters(const RaspiVoiceOptions &opt);
+	void updateConverter();
+	cv::Mat readImage(bool retrieve);
+	void readAndScaleImage();
+	void scaleImage(cv::Mat rawImage);
+	void accumulateFrame(bool first, int frame_count);
+	void averageFrame();
+	void processImage();
 	int playWav(std::string filename);
+	void recordAudio(const float *samples, int frame_count, int sample_freq_Hz, int channels, std::string prefix, int segment_s);
+	void publishSweepImage();
+	static void *runSweepThread(void *arg);
+	void sweepLoop();
 public:
 	RaspiVoice(RaspiVoiceOptions opt);
 	~RaspiVoice();
@@ -14,6 +14,7 @@
 
 #include <iostream>
 #include <thread>
+#include <memory>
 #include <cmath>
 #include <cinttypes>
 #include <unistd.h>
@@ -28,6 +29,8 @@
 #include "RaspiVoice.h"
 #include "KeyboardInput.h"
 #include "AudioData.h"
+#include "SpeechCache.h"
+#include "Benchmark.h"
 
 void *run_worker_thread(void *arg);
 bool setup_screen(void);
@@ -56,6 +59,12 @@ int main(int argc, char *argv[])
 
 	cmdline_opt = GetCommandLineOptions();
 
+	if (cmdline_opt.benchmark)
+	{
+		RunBenchmark(cmdline_opt);
+		return 0;
+	}
+
 	if (cmdline_opt.daemon)
 	{
 		std::cout << "raspivoice daemon started." << std::endl;
@@ -100,7 +109,22 @@ int main(int argc, char *argv[])
 	//Start Program in worker thread:
 	//Warning: Do not read or write rvopt or quit_flag without locking after this.
 	pthread_t thr;
-	AudioData::Init();
+	DynamicsParameters dynamics;
+	dynamics.limiter = cmdline_opt.limiter;
+	dynamics.ceiling_dB = cmdline_opt.limiter_ceiling_db;
+	dynamics.lookahead_ms = cmdline_opt.limiter_lookahead_ms;
+	dynamics.release_ms = cmdline_opt.limiter_release_ms;
+	dynamics.agc = cmdline_opt.agc;
+	dynamics.agc_target_dB = cmdline_opt.agc_target_db;
+	dynamics.agc_max_gain_dB = cmdline_opt.agc_max_gain_db;
+	dynamics.agc_time_s = cmdline_opt.agc_time_s;
+	//Before the screen setup, which redirects stdout:
+	AudioData::Init(cmdline_opt.audio_card, cmdline_opt.sample_freq_Hz, cmdline_opt.speech_ducking, cmdline_opt.verbose, cmdline_opt.pcm_stream,
+					(SampleFormat)cmdline_opt.output_format, cmdline_opt.dither, dynamics);
+	//Soundscapes are rendered at the device rate, so they need no resampling:
+	cmdline_opt.sample_freq_Hz = AudioData::GetDeviceSampleFreq();
+	SetCommandLineSampleFreq(cmdline_opt.sample_freq_Hz);
+	rvopt.sample_freq_Hz = cmdline_opt.sample_freq_Hz;
 	if (pthread_create(&thr, NULL, run_worker_thread, NULL))
 	{
 		std::cerr << "Error setting up thread." << std::endl;
@@ -140,6 +164,8 @@ int main(int argc, char *argv[])
 	//Wait for worker thread:
 	pthread_join(thr, nullptr);
 
+	AudioData::Shutdown();
+
 	//Check for exception from worker thread:
 	if (exc_ptr != nullptr)
 	{
@@ -239,6 +265,18 @@ void main_loop(KeyboardInput &keyboardInput)
 {
 	bool quit = false;
 	AudioData audioData(cmdline_opt.audio_card);
+	audioData.Verbose = cmdline_opt.verbose;
+	if (cmdline_opt.volume != -1)
+	{
+		audioData.SetVolume(cmdline_opt.volume);
+	}
+
+	//Announcements are played on the speech thread, key presses are never blocked by speech:
+	std::unique_ptr<SpeechCache> speechCache;
+	if (cmdline_opt.speak)
+	{
+		speechCache.reset(new SpeechCache(audioData, cmdline_opt.speech_cache_dir, cmdline_opt.verbose));
+	}
 
 	while (!quit)
 	{
@@ -268,12 +306,9 @@ void main_loop(KeyboardInput &keyboardInput)
 			pthread_mutex_unlock(&rvopt_mutex);
 
 			//Speak state_str?
-			if ((cmdline_opt.speak) && (state_str != ""))
+			if ((speechCache) && (state_str != ""))
 			{
-				if (!audioData.Speak(state_str))
-				{
-					std::cerr << "Error calling Speak(). Use verbose mode for more info." << std::endl;
-				}
+				speechCache->Say(state_str);
 			}
 
 		}
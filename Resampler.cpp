@@ -0,0 +1,106 @@
+#include <cmath>
+#include <cinttypes>
+#include <algorithm>
+
+#include "Resampler.h"
+
+#define Pi 3.14159265358979323846
+
+const int Resampler::maxPhases;
+const int Resampler::baseTaps;
+
+static int gcd(int a, int b)
+{
+	while (b != 0)
+	{
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+Resampler::Resampler(int in_freq_Hz, int out_freq_Hz) :
+	in_freq_Hz(in_freq_Hz),
+	out_freq_Hz(out_freq_Hz)
+{
+	int g = gcd(in_freq_Hz, out_freq_Hz);
+	up = out_freq_Hz / g;
+	down = in_freq_Hz / g;
+	phases = std::min(up, maxPhases);
+
+	//Cutoff a bit below the lower Nyquist frequency, in input samples. Downsampling needs a longer filter:
+	double cutoff = 0.95 * std::min(1.0, (double)out_freq_Hz / in_freq_Hz);
+	taps = 2 * (int)ceil(0.5 * baseTaps / std::min(1.0, (double)out_freq_Hz / in_freq_Hz));
+	double half_width = 0.5 * taps;
+
+	coefficients.resize(phases * taps);
+	for (int p = 0; p < phases; p++)
+	{
+		//Tap k weighs input sample i - taps/2 + 1 + k for output position i + p/phases:
+		double frac = (double)p / phases;
+		float *h = &coefficients[p * taps];
+		double sum = 0;
+		for (int k = 0; k < taps; k++)
+		{
+			double t = frac + half_width - 1 - k;
+			double x = Pi * cutoff * t;
+			double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+			double w = (fabs(t) < half_width) ? (0.42 + 0.5 * cos(Pi * t / half_width) + 0.08 * cos(2 * Pi * t / half_width)) : 0.0;
+			h[k] = cutoff * sinc * w;
+			sum += h[k];
+		}
+		//Unity gain at DC in every phase:
+		for (int k = 0; k < taps; k++)
+		{
+			h[k] /= sum;
+		}
+	}
+}
+
+size_t Resampler::GetOutputFrames(size_t in_frames) const
+{
+	return (size_t)(((uint64_t)in_frames * up + down - 1) / down);
+}
+
+void Resampler::Process(const float *in, size_t in_frames, int in_stride, float *out, int out_stride) const
+{
+	size_t out_frames = GetOutputFrames(in_frames);
+	for (size_t n = 0; n < out_frames; n++)
+	{
+		//Position n * down / up in input samples, as integer part and phase:
+		uint64_t position = (uint64_t)n * down;
+		int64_t i = position / up;
+		int p = (int)(((position % up) * phases + up / 2) / up);
+		if (p == phases)
+		{
+			i++;
+			p = 0;
+		}
+
+		const float *h = &coefficients[p * taps];
+		int64_t first = i - taps / 2 + 1;
+		float y = 0.0f;
+		if ((first >= 0) && (first + taps <= (int64_t)in_frames))
+		{
+			const float *x = &in[first * in_stride];
+			for (int k = 0; k < taps; k++)
+			{
+				y += h[k] * x[k * in_stride];
+			}
+		}
+		else
+		{
+			//Zeros outside the buffer:
+			for (int k = 0; k < taps; k++)
+			{
+				int64_t j = first + k;
+				if ((j >= 0) && (j < (int64_t)in_frames))
+				{
+					y += h[k] * in[j * in_stride];
+				}
+			}
+		}
+		out[n * out_stride] = y;
+	}
+}
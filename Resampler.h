@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+//Polyphase windowed-sinc resampler for a fixed rate ratio. The ratio is reduced to up/down, one filter
+//phase per output position up to maxPhases, beyond that the nearest phase is used.
+//Buffers are converted as a whole (speech, cues), there is no state between calls.
+class Resampler
+{
+private:
+	static const int maxPhases = 512;
+	static const int baseTaps = 32;
+
+	const int in_freq_Hz;
+	const int out_freq_Hz;
+	int up;
+	int down;
+	int phases;
+	int taps;
+	std::vector<float> coefficients; //phases * taps
+public:
+	Resampler(int in_freq_Hz, int out_freq_Hz);
+
+	size_t GetOutputFrames(size_t in_frames) const;
+	//Resamples one channel, samples are stride apart in in and out.
+	void Process(const float *in, size_t in_frames, int in_stride, float *out, int out_stride) const;
+	int GetInFreq() const { return in_freq_Hz; }
+	int GetOutFreq() const { return out_freq_Hz; }
+};
@@ -0,0 +1,151 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "SampleConversion.h"
+
+int GetSampleBytes(SampleFormat format)
+{
+	switch (format)
+	{
+		case SampleFormat::S24:
+			return 3;
+		case SampleFormat::S32:
+		case SampleFormat::Float:
+			return 4;
+		default:
+			return 2;
+	}
+}
+
+const char *GetSampleFormatName(SampleFormat format)
+{
+	switch (format)
+	{
+		case SampleFormat::S24:
+			return "S24_3LE";
+		case SampleFormat::S32:
+			return "S32_LE";
+		case SampleFormat::Float:
+			return "FLOAT_LE";
+		default:
+			return "S16_LE";
+	}
+}
+
+void FloatToS16(const float *src, int16_t *dst, size_t count, float gain)
+{
+	float scale = 32768.0f * gain;
+	size_t i = 0;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	//vcvtq truncates, so half an LSB with the sign of the sample is added first. Out of range
+	//values saturate in the conversion to 32 bits and again in the narrowing to 16 bits.
+	float32x4_t vscale = vdupq_n_f32(scale);
+	uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+	uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+	for (; i + 8 <= count; i += 8)
+	{
+		float32x4_t a = vmulq_f32(vld1q_f32(src + i), vscale);
+		float32x4_t b = vmulq_f32(vld1q_f32(src + i + 4), vscale);
+		a = vaddq_f32(a, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(a), sign_mask), half)));
+		b = vaddq_f32(b, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(b), sign_mask), half)));
+		int16x8_t s = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b)));
+		vst1q_s16(dst + i, s);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float s = std::min(std::max(scale * src[i], -32768.0f), 32767.0f);
+		dst[i] = (int16_t)lrintf(s);
+	}
+}
+
+//Uniform in [-0.5, 0.5), xorshift32:
+static inline float ditherNoise(uint32_t &seed)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed * (1.0f / 4294967296.0f) - 0.5f;
+}
+
+static void floatToS16Dithered(const float *src, int16_t *dst, size_t count, float gain, uint32_t &seed)
+{
+	float scale = 32768.0f * gain;
+	if (seed == 0)
+	{
+		seed = 0x9e3779b9;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		//Sum of two uniform variables: triangular density, noise independent of the signal:
+		float s = scale * src[i] + ditherNoise(seed) + ditherNoise(seed);
+		s = std::min(std::max(s, -32768.0f), 32767.0f);
+		dst[i] = (int16_t)lrintf(s);
+	}
+}
+
+void ConvertSamples(const float *src, void *dst, size_t count, SampleFormat format, float gain, uint32_t *dither_seed)
+{
+	switch (format)
+	{
+		case SampleFormat::S16:
+			if (dither_seed != nullptr)
+			{
+				floatToS16Dithered(src, (int16_t*)dst, count, gain, *dither_seed);
+			}
+			else
+			{
+				FloatToS16(src, (int16_t*)dst, count, gain);
+			}
+			break;
+
+		case SampleFormat::S24:
+		{
+			float scale = 8388608.0f * gain;
+			uint8_t *p = (uint8_t*)dst;
+			for (size_t i = 0; i < count; i++, p += 3)
+			{
+				float s = std::min(std::max(scale * src[i], -8388608.0f), 8388607.0f);
+				int32_t v = lrintf(s);
+				p[0] = v & 0xff;
+				p[1] = (v >> 8) & 0xff;
+				p[2] = (v >> 16) & 0xff;
+			}
+			break;
+		}
+
+		case SampleFormat::S32:
+		{
+			//Largest float below 2^31, so the conversion cannot overflow:
+			float scale = 2147483648.0f * gain;
+			int32_t *p = (int32_t*)dst;
+			for (size_t i = 0; i < count; i++)
+			{
+				float s = std::min(std::max(scale * src[i], -2147483648.0f), 2147483520.0f);
+				p[i] = (int32_t)lrintf(s);
+			}
+			break;
+		}
+
+		case SampleFormat::Float:
+			if (gain == 1.0f)
+			{
+				memcpy(dst, src, count * sizeof(float));
+			}
+			else
+			{
+				float *p = (float*)dst;
+				for (size_t i = 0; i < count; i++)
+				{
+					p[i] = gain * src[i];
+				}
+			}
+			break;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cinttypes>
+
+//Output sample formats, little endian. S24 is packed into 3 bytes (ALSA S24_3LE, 24-bit WAV).
+enum class SampleFormat
+{
+	S16 = 0,
+	S24,
+	S32,
+	Float
+};
+
+int GetSampleBytes(SampleFormat format);
+const char *GetSampleFormatName(SampleFormat format);
+
+//Float samples at full scale +-1.0 to signed 16 bits, multiplied by gain, rounded and saturated (NEON on ARM).
+void FloatToS16(const float *src, int16_t *dst, size_t count, float gain = 1.0f);
+
+//Float samples to any output format, multiplied by gain. Integer formats are rounded and saturated,
+//float samples are not clipped. If dither_seed is not null, TPDF dither of +-1 LSB is added when
+//reducing to 16 bits; the seed carries the noise generator from one call to the next.
+void ConvertSamples(const float *src, void *dst, size_t count, SampleFormat format, float gain = 1.0f, uint32_t *dither_seed = nullptr);
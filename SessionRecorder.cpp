@@ -0,0 +1,131 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include <ctime>
+
+#include "SessionRecorder.h"
+
+SessionRecorder::SessionRecorder(std::string prefix, int sample_freq_Hz, int channels, int segment_s, int buffer_s, bool verbose) :
+	prefix(prefix),
+	sample_freq_Hz(sample_freq_Hz),
+	channels(channels),
+	segment_frames((uint64_t)sample_freq_Hz * std::max(segment_s, 1)),
+	verbose(verbose),
+	ring((size_t)sample_freq_Hz * channels * std::max(buffer_s, 1)),
+	segment_index(0),
+	dropped_frames(0),
+	quit(false)
+{
+	time_t now = time(NULL);
+	struct tm local;
+	localtime_r(&now, &local);
+	char timestamp[32];
+	strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &local);
+	session_start = timestamp;
+
+	if (pthread_create(&writer_thread, NULL, runWriterThread, this))
+	{
+		throw(std::runtime_error("Error setting up recorder thread."));
+	}
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	quit = true;
+	pthread_join(writer_thread, nullptr);
+
+	if (verbose && (dropped_frames > 0))
+	{
+		std::cout << "Recorder: " << dropped_frames << " frames dropped" << std::endl;
+	}
+}
+
+void SessionRecorder::Record(const int16_t *samples, size_t frame_count)
+{
+	if (!ring.Write(samples, frame_count * channels))
+	{
+		dropped_frames += frame_count;
+	}
+}
+
+void *SessionRecorder::runWriterThread(void *arg)
+{
+	static_cast<SessionRecorder*>(arg)->writerLoop();
+	return nullptr;
+}
+
+void SessionRecorder::startSegment()
+{
+	std::stringstream filename;
+	filename << prefix << "_" << session_start << "_" << std::setw(3) << std::setfill('0') << segment_index << ".wav";
+	segment_index++;
+
+	if (!writer.Open(filename.str(), sample_freq_Hz, channels))
+	{
+		std::cerr << "Cannot open recording file " << filename.str() << std::endl;
+	}
+	else if (verbose)
+	{
+		std::cout << "Recording to " << filename.str() << std::endl;
+	}
+}
+
+void SessionRecorder::writerLoop()
+{
+	struct timespec idle = { 0, 50000000L }; //50 ms
+	int16_t frame[8];
+	bool failed = false;
+
+	while (true)
+	{
+		bool stopping = quit;
+
+		size_t count;
+		const int16_t *samples = ring.Peek(count);
+		if (count == 0)
+		{
+			if (stopping)
+			{
+				break;
+			}
+			nanosleep(&idle, NULL);
+			continue;
+		}
+
+		if (!failed && (!writer.IsOpen() || (writer.GetFrameCount() >= segment_frames)))
+		{
+			startSegment();
+			failed = !writer.IsOpen();
+		}
+
+		//Whole frames up to the end of the segment, the ring may wrap inside a frame:
+		size_t frames = count / channels;
+		if (!failed)
+		{
+			frames = std::min((uint64_t)frames, segment_frames - writer.GetFrameCount());
+		}
+		bool copied = (frames == 0);
+		if (copied)
+		{
+			ring.Read(frame, channels);
+			samples = frame;
+			frames = 1;
+		}
+
+		if (!failed && !writer.Write(samples, frames))
+		{
+			std::cerr << "Error writing recording, stopped." << std::endl;
+			writer.Close();
+			failed = true;
+		}
+
+		if (!copied)
+		{
+			ring.Consume(frames * channels);
+		}
+	}
+
+	writer.Close();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cinttypes>
+#include <pthread.h>
+
+#include "SpscRing.h"
+#include "WavWriter.h"
+
+//Records every played soundscape into WAV segment files <prefix>_<date>_<time>_<segment>.wav,
+//starting a new file every segment_s seconds of audio. Record() only copies into a bounded
+//ring, the files are written on a background thread. Audio that does not fit is dropped and counted.
+class SessionRecorder
+{
+private:
+	const std::string prefix;
+	const int sample_freq_Hz;
+	const int channels;
+	const uint64_t segment_frames;
+	bool verbose;
+
+	SpscRing<int16_t> ring;
+	WavWriter writer;
+	std::string session_start;
+	int segment_index;
+	std::atomic<uint64_t> dropped_frames;
+	std::atomic<bool> quit;
+	pthread_t writer_thread;
+
+	SessionRecorder(const SessionRecorder& other) = delete;
+	SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+	static void *runWriterThread(void *arg);
+	void writerLoop();
+	void startSegment();
+public:
+	//buffer_s: ring size, how far the disk may fall behind.
+	SessionRecorder(std::string prefix, int sample_freq_Hz, int channels, int segment_s = 600, int buffer_s = 10, bool verbose = false);
+	//Writes what is left in the ring and closes the file.
+	~SessionRecorder();
+
+	//Queues interleaved frames, returns immediately.
+	void Record(const int16_t *samples, size_t frame_count);
+	uint64_t GetDroppedFrames() { return dropped_frames.load(); }
+	int GetSampleFreq() { return sample_freq_Hz; }
+	int GetChannels() { return channels; }
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+//Shared memory ring of 8-bit grayscale frames, for feeding raspivoice (--image_source=-1) from other processes.
+//This header is all a producer needs: shm_open/mmap, GCC atomics and the futex syscall, link with -lrt.
+//
+//The producer writes frames into the slots in turn and then publishes them by increasing sequence.
+//No syscall is made unless a consumer is blocked waiting for a frame. Consumers read a slot in place
+//and check afterwards that slot_sequence has not changed, i.e. that the producer did not reuse the slot meanwhile.
+
+#include <string>
+#include <stdexcept>
+#include <cstring>
+#include <cinttypes>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHARED_FRAME_RING_MAGIC 0x52465652 //"RVFR"
+#define SHARED_FRAME_RING_VERSION 1
+#define SHARED_FRAME_RING_MAX_SLOTS 16
+#define SHARED_FRAME_RING_DATA_OFFSET 4096
+
+struct SharedFrameRingHeader
+{
+	uint32_t magic; //set last by the producer, after the rest of the header
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t slot_count;
+	uint32_t slot_size; //bytes per slot, rows are width bytes without padding
+	uint32_t sequence; //number of the newest published frame, starting at 1; futex word
+	uint32_t waiters; //consumers blocked on sequence
+	uint32_t slot_sequence[SHARED_FRAME_RING_MAX_SLOTS]; //frame in the slot, 0 while it is written
+};
+
+inline size_t SharedFrameRingSize(uint32_t slot_count, uint32_t slot_size)
+{
+	return SHARED_FRAME_RING_DATA_OFFSET + (size_t)slot_count * slot_size;
+}
+
+class SharedFrameRingProducer
+{
+private:
+	std::string name;
+	int fd;
+	SharedFrameRingHeader *header;
+	uint8_t *data;
+	size_t map_size;
+	uint32_t next_sequence;
+	uint32_t next_slot;
+
+	SharedFrameRingProducer(const SharedFrameRingProducer& other) = delete;
+	SharedFrameRingProducer& operator=(const SharedFrameRingProducer&) = delete;
+public:
+	//name: POSIX shared memory name, e.g. "/raspivoice_frames".
+	SharedFrameRingProducer(std::string name, int width, int height, int slot_count = 4) :
+		name(name),
+		fd(-1),
+		header(nullptr),
+		data(nullptr),
+		next_sequence(1),
+		next_slot(0)
+	{
+		if ((width <= 0) || (height <= 0) || (slot_count < 2) || (slot_count > SHARED_FRAME_RING_MAX_SLOTS))
+		{
+			throw(std::runtime_error("Invalid shared frame ring size."));
+		}
+
+		uint32_t slot_size = ((uint32_t)(width * height) + 63) & ~63u;
+		map_size = SharedFrameRingSize(slot_count, slot_size);
+
+		fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+		if ((fd == -1) || (ftruncate(fd, map_size) == -1))
+		{
+			throw(std::runtime_error("Cannot create shared memory " + name + "."));
+		}
+
+		void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			close(fd);
+			throw(std::runtime_error("Cannot map shared memory " + name + "."));
+		}
+		header = (SharedFrameRingHeader*)p;
+		data = (uint8_t*)p + SHARED_FRAME_RING_DATA_OFFSET;
+
+		__atomic_store_n(&header->magic, 0, __ATOMIC_RELEASE);
+		header->version = SHARED_FRAME_RING_VERSION;
+		header->width = width;
+		header->height = height;
+		header->slot_count = slot_count;
+		header->slot_size = slot_size;
+		header->sequence = 0;
+		header->waiters = 0;
+		memset(header->slot_sequence, 0, sizeof(header->slot_sequence));
+		__atomic_store_n(&header->magic, SHARED_FRAME_RING_MAGIC, __ATOMIC_RELEASE);
+	}
+
+	~SharedFrameRingProducer()
+	{
+		munmap(header, map_size);
+		close(fd);
+	}
+
+	//Removes the name, consumers that have it open keep their mapping.
+	void Unlink()
+	{
+		shm_unlink(name.c_str());
+	}
+
+	//Returns the slot to write the next frame to: height rows of width bytes.
+	uint8_t *BeginFrame()
+	{
+		__atomic_store_n(&header->slot_sequence[next_slot], 0, __ATOMIC_RELEASE);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		return data + (size_t)next_slot * header->slot_size;
+	}
+
+	//Publishes the frame written since BeginFrame().
+	void PublishFrame()
+	{
+		__atomic_store_n(&header->slot_sequence[next_slot], next_sequence, __ATOMIC_RELEASE);
+		__atomic_store_n(&header->sequence, next_sequence, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&header->waiters, __ATOMIC_SEQ_CST) > 0)
+		{
+			syscall(SYS_futex, &header->sequence, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+		}
+
+		next_sequence++;
+		next_slot = (next_slot + 1) % header->slot_count;
+	}
+};
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "SharedFrameSource.h"
+
+SharedFrameSource::SharedFrameSource() :
+	fd(-1),
+	header(nullptr),
+	data(nullptr),
+	map_size(0),
+	last_sequence(0),
+	last_slot(-1),
+	verbose(false)
+{
+}
+
+SharedFrameSource::~SharedFrameSource()
+{
+	Close();
+}
+
+void SharedFrameSource::Open(std::string name, bool verbose)
+{
+	Close();
+	this->verbose = verbose;
+
+	fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd == -1)
+	{
+		throw(std::runtime_error("Could not open shared memory " + name + ". Is the frame producer running?"));
+	}
+
+	//Map the header first to get the size of the ring:
+	void *p = mmap(NULL, SHARED_FRAME_RING_DATA_OFFSET, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		Close();
+		throw(std::runtime_error("Could not map shared memory " + name + "."));
+	}
+	SharedFrameRingHeader *h = (SharedFrameRingHeader*)p;
+	bool valid = (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == SHARED_FRAME_RING_MAGIC) && (h->version == SHARED_FRAME_RING_VERSION)
+		&& (h->slot_count >= 2) && (h->slot_count <= SHARED_FRAME_RING_MAX_SLOTS) && (h->slot_size >= h->width * h->height);
+	size_t size = valid ? SharedFrameRingSize(h->slot_count, h->slot_size) : 0;
+	munmap(p, SHARED_FRAME_RING_DATA_OFFSET);
+
+	struct stat st;
+	if (!valid || (fstat(fd, &st) == -1) || ((size_t)st.st_size < size))
+	{
+		Close();
+		throw(std::runtime_error("Shared memory " + name + " does not contain a frame ring."));
+	}
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		Close();
+		throw(std::runtime_error("Could not map shared memory " + name + "."));
+	}
+	map_size = size;
+	header = (SharedFrameRingHeader*)p;
+	data = (const uint8_t*)p + SHARED_FRAME_RING_DATA_OFFSET;
+	last_sequence = 0;
+	last_slot = -1;
+
+	if (verbose)
+	{
+		std::cout << "Shared memory frames " << header->width << "x" << header->height << ", " << header->slot_count << " slots" << std::endl;
+	}
+}
+
+void SharedFrameSource::Close()
+{
+	if (header != nullptr)
+	{
+		munmap(header, map_size);
+		header = nullptr;
+		data = nullptr;
+	}
+	if (fd != -1)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+//Returns false on timeout.
+bool SharedFrameSource::waitForFrame(uint32_t seen_sequence, int timeout_ms)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += timeout_ms / 1000;
+	end.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (end.tv_nsec >= 1000000000L)
+	{
+		end.tv_sec++;
+		end.tv_nsec -= 1000000000L;
+	}
+
+	__atomic_add_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+	bool published = false;
+	while (true)
+	{
+		if (__atomic_load_n(&header->sequence, __ATOMIC_SEQ_CST) != seen_sequence)
+		{
+			published = true;
+			break;
+		}
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		struct timespec remaining;
+		remaining.tv_sec = end.tv_sec - now.tv_sec;
+		remaining.tv_nsec = end.tv_nsec - now.tv_nsec;
+		if (remaining.tv_nsec < 0)
+		{
+			remaining.tv_sec--;
+			remaining.tv_nsec += 1000000000L;
+		}
+		if (remaining.tv_sec < 0)
+		{
+			break;
+		}
+
+		//Sleeps only while sequence still has the value seen:
+		if ((syscall(SYS_futex, &header->sequence, FUTEX_WAIT, seen_sequence, &remaining, NULL, 0) == -1)
+			&& (errno != EAGAIN) && (errno != EINTR) && (errno != ETIMEDOUT))
+		{
+			break;
+		}
+	}
+	__atomic_sub_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+
+	return published;
+}
+
+cv::Mat SharedFrameSource::Grab(int new_frame_timeout_ms)
+{
+	uint32_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+	if (sequence == 0)
+	{
+		if (!waitForFrame(0, 2000))
+		{
+			throw(std::runtime_error("Timeout waiting for frame from shared memory."));
+		}
+	}
+	else if ((sequence == last_sequence) && (new_frame_timeout_ms > 0))
+	{
+		waitForFrame(sequence, new_frame_timeout_ms);
+	}
+
+	//The producer may lap a slow reader, take the newest frame whose slot is complete:
+	while (true)
+	{
+		sequence = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+		int slot = (sequence - 1) % header->slot_count;
+		if (__atomic_load_n(&header->slot_sequence[slot], __ATOMIC_ACQUIRE) == sequence)
+		{
+			last_sequence = sequence;
+			last_slot = slot;
+			break;
+		}
+	}
+
+	return cv::Mat(header->height, header->width, CV_8UC1, (void*)(data + (size_t)last_slot * header->slot_size), header->width);
+}
+
+bool SharedFrameSource::IsUnchanged()
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return (last_slot != -1) && (__atomic_load_n(&header->slot_sequence[last_slot], __ATOMIC_ACQUIRE) == last_sequence);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <cinttypes>
+#include <opencv/cv.h>
+
+#include "SharedFrameRing.h"
+
+//Consumer side of SharedFrameRing: frames are used in place, without copying.
+class SharedFrameSource
+{
+private:
+	int fd;
+	SharedFrameRingHeader *header;
+	const uint8_t *data;
+	size_t map_size;
+	uint32_t last_sequence;
+	int last_slot;
+	bool verbose;
+
+	SharedFrameSource(const SharedFrameSource& other) = delete;
+	SharedFrameSource& operator=(const SharedFrameSource&) = delete;
+
+	bool waitForFrame(uint32_t seen_sequence, int timeout_ms);
+public:
+	SharedFrameSource();
+	~SharedFrameSource();
+
+	void Open(std::string name, bool verbose = false);
+	void Close();
+	bool IsOpen() { return fd != -1; }
+
+	//Returns the newest frame (CV_8UC1 header on the shared slot). Waits up to new_frame_timeout_ms
+	//for a frame that has not been returned before, then returns the newest one again.
+	cv::Mat Grab(int new_frame_timeout_ms = 100);
+	//False if the producer has started to overwrite the slot of the last Grab() since then.
+	bool IsUnchanged();
+
+	int GetWidth() { return (header != nullptr) ? header->width : 0; }
+	int GetHeight() { return (header != nullptr) ? header->height : 0; }
+};
@@ -0,0 +1,256 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <espeak/speak_lib.h>
+
+#include "SpeechCache.h"
+#include "printtime.h"
+
+static const uint32_t speech_file_magic = 0x50535652; //"RVSP"
+
+static int synthCallback(short *wav, int numsamples, espeak_EVENT *events)
+{
+	std::vector<int16_t> *samples = static_cast<std::vector<int16_t>*>(events->user_data);
+	if ((wav != NULL) && (samples != NULL))
+	{
+		samples->insert(samples->end(), wav, wav + numsamples);
+	}
+	return 0;
+}
+
+SpeechCache::SpeechCache(AudioData &audioData, std::string cache_dir, bool verbose) :
+	audioData(audioData),
+	cache_dir(cache_dir),
+	verbose(verbose),
+	sample_freq_Hz(0),
+	text_pending(false),
+	quit(false)
+{
+	pthread_mutex_init(&speech_mutex, NULL);
+	pthread_cond_init(&speech_cond, NULL);
+
+	if (pthread_create(&speech_thread, NULL, runSpeechThread, this))
+	{
+		throw(std::runtime_error("Error setting up speech thread."));
+	}
+}
+
+SpeechCache::~SpeechCache()
+{
+	//A pending announcement (e.g. "goodbye") is still played:
+	pthread_mutex_lock(&speech_mutex);
+	quit = true;
+	pthread_cond_broadcast(&speech_cond);
+	pthread_mutex_unlock(&speech_mutex);
+
+	pthread_join(speech_thread, nullptr);
+
+	if (sample_freq_Hz > 0)
+	{
+		espeak_Terminate();
+	}
+
+	pthread_cond_destroy(&speech_cond);
+	pthread_mutex_destroy(&speech_mutex);
+}
+
+void SpeechCache::Say(std::string text)
+{
+	pthread_mutex_lock(&speech_mutex);
+	pending_text = text;
+	text_pending = true;
+	pthread_cond_broadcast(&speech_cond);
+	pthread_mutex_unlock(&speech_mutex);
+}
+
+void *SpeechCache::runSpeechThread(void *arg)
+{
+	static_cast<SpeechCache*>(arg)->speechLoop();
+	return nullptr;
+}
+
+void SpeechCache::speechLoop()
+{
+	//The espeak library is not thread safe, it is only used from this thread:
+	sample_freq_Hz = espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, NULL, 0);
+	if (sample_freq_Hz <= 0)
+	{
+		sample_freq_Hz = 0;
+		if (verbose)
+		{
+			std::cout << "espeak library not available, using espeak command." << std::endl;
+		}
+	}
+	else
+	{
+		espeak_SetSynthCallback(synthCallback);
+	}
+
+	pthread_mutex_lock(&speech_mutex);
+	while (true)
+	{
+		while (!text_pending && !quit)
+		{
+			pthread_cond_wait(&speech_cond, &speech_mutex);
+		}
+		if (!text_pending)
+		{
+			break;
+		}
+
+		std::string text = pending_text;
+		text_pending = false;
+		pthread_mutex_unlock(&speech_mutex);
+
+		const std::vector<int16_t> *samples = getPhrase(text);
+		if (samples != nullptr)
+		{
+			audioData.PlayPcm(samples->data(), samples->size(), sample_freq_Hz, 1, AudioMixer::Voice::Speech);
+		}
+		else if (!audioData.Speak(text))
+		{
+			std::cerr << "Error calling Speak(). Use verbose mode for more info." << std::endl;
+		}
+
+		pthread_mutex_lock(&speech_mutex);
+	}
+	pthread_mutex_unlock(&speech_mutex);
+}
+
+const std::vector<int16_t> *SpeechCache::getPhrase(const std::string &text)
+{
+	if (sample_freq_Hz == 0)
+	{
+		return nullptr;
+	}
+
+	auto it = phrases.find(text);
+	if (it != phrases.end())
+	{
+		return &it->second;
+	}
+
+	std::vector<int16_t> samples;
+	if (!loadPhrase(text, samples))
+	{
+		if (verbose)
+		{
+			printtime("Synthesizing \"" + text + "\"");
+		}
+
+		if (!synthesize(text, samples))
+		{
+			return nullptr;
+		}
+		savePhrase(text, samples);
+	}
+
+	std::vector<int16_t> &cached = phrases[text];
+	cached.swap(samples);
+	return &cached;
+}
+
+bool SpeechCache::synthesize(const std::string &text, std::vector<int16_t> &samples)
+{
+	samples.clear();
+	if (espeak_Synth(text.c_str(), text.size() + 1, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, NULL, &samples) != EE_OK)
+	{
+		return false;
+	}
+	return !samples.empty();
+}
+
+std::string SpeechCache::cacheFilename(const std::string &text)
+{
+	//FNV-1a, stable across runs:
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ULL;
+	}
+
+	std::stringstream filename;
+	filename << cache_dir << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".pcm";
+	return filename.str();
+}
+
+bool SpeechCache::loadPhrase(const std::string &text, std::vector<int16_t> &samples)
+{
+	if (cache_dir == "")
+	{
+		return false;
+	}
+
+	FILE *fp = fopen(cacheFilename(text).c_str(), "rb");
+	if (fp == NULL)
+	{
+		return false;
+	}
+
+	uint32_t header[3];
+	bool ok = (fread(header, sizeof(header), 1, fp) == 1) && (header[0] == speech_file_magic)
+		&& (header[1] == (uint32_t)sample_freq_Hz) && (header[2] == text.size());
+
+	if (ok)
+	{
+		//Check against hash collisions:
+		std::string file_text(text.size(), ' ');
+		ok = (fread(&file_text[0], 1, text.size(), fp) == text.size()) && (file_text == text);
+	}
+
+	uint32_t sample_count = 0;
+	if (ok)
+	{
+		ok = (fread(&sample_count, sizeof(sample_count), 1, fp) == 1) && (sample_count > 0);
+	}
+
+	if (ok)
+	{
+		samples.resize(sample_count);
+		ok = (fread(samples.data(), sizeof(int16_t), sample_count, fp) == sample_count);
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+void SpeechCache::savePhrase(const std::string &text, const std::vector<int16_t> &samples)
+{
+	if (cache_dir == "")
+	{
+		return;
+	}
+
+	//Create cache directory including parents, errors show up at fopen:
+	for (size_t pos = cache_dir.find('/', 1); ; pos = cache_dir.find('/', pos + 1))
+	{
+		mkdir(cache_dir.substr(0, pos).c_str(), 0755);
+		if (pos == std::string::npos)
+		{
+			break;
+		}
+	}
+
+	FILE *fp = fopen(cacheFilename(text).c_str(), "wb");
+	if (fp == NULL)
+	{
+		if (verbose)
+		{
+			std::cout << "Cannot write speech cache file in " << cache_dir << std::endl;
+		}
+		return;
+	}
+
+	uint32_t header[3] = { speech_file_magic, (uint32_t)sample_freq_Hz, (uint32_t)text.size() };
+	uint32_t sample_count = samples.size();
+	fwrite(header, sizeof(header), 1, fp);
+	fwrite(text.data(), 1, text.size(), fp);
+	fwrite(&sample_count, sizeof(sample_count), 1, fp);
+	fwrite(samples.data(), sizeof(int16_t), sample_count, fp);
+	fclose(fp);
+}
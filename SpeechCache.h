@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cinttypes>
+#include <pthread.h>
+
+#include "AudioData.h"
+
+//Menu announcements, synthesized once with the espeak library and kept as PCM in memory and on disk.
+//Say() only queues the text, synthesis and playback run on the speech thread.
+class SpeechCache
+{
+private:
+	AudioData &audioData;
+	std::string cache_dir;
+	bool verbose;
+	int sample_freq_Hz; //0 if the espeak library could not be initialized
+	std::map<std::string, std::vector<int16_t>> phrases;
+
+	bool text_pending;
+	std::string pending_text;
+	bool quit;
+	pthread_mutex_t speech_mutex;
+	pthread_cond_t speech_cond;
+	pthread_t speech_thread;
+
+	SpeechCache(const SpeechCache& other) = delete;
+	SpeechCache& operator=(const SpeechCache&) = delete;
+
+	static void *runSpeechThread(void *arg);
+	void speechLoop();
+	const std::vector<int16_t> *getPhrase(const std::string &text);
+	bool synthesize(const std::string &text, std::vector<int16_t> &samples);
+	std::string cacheFilename(const std::string &text);
+	bool loadPhrase(const std::string &text, std::vector<int16_t> &samples);
+	void savePhrase(const std::string &text, const std::vector<int16_t> &samples);
+public:
+	SpeechCache(AudioData &audioData, std::string cache_dir, bool verbose = false);
+	~SpeechCache();
+
+	//Replaces any announcement that has not started yet.
+	void Say(std::string text);
+};
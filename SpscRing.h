@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <algorithm>
+
+//Lock-free ring buffer for one producer thread and one consumer thread.
+//The producer never blocks: Write() fails if there is not enough space.
+template<typename T>
+class SpscRing
+{
+private:
+	std::vector<T> buffer;
+	const size_t mask;
+	std::atomic<size_t> head; //total elements written, only changed by the producer
+	std::atomic<size_t> tail; //total elements read, only changed by the consumer
+
+	static size_t roundUpToPowerOfTwo(size_t n)
+	{
+		size_t size = 1;
+		while (size < n)
+		{
+			size <<= 1;
+		}
+		return size;
+	}
+
+	SpscRing(const SpscRing& other) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+public:
+	//capacity is rounded up to a power of two.
+	explicit SpscRing(size_t capacity) :
+		buffer(roundUpToPowerOfTwo(capacity)),
+		mask(buffer.size() - 1),
+		head(0),
+		tail(0)
+	{
+	}
+
+	size_t Capacity() const { return buffer.size(); }
+
+	//Producer: writes all count elements or nothing.
+	bool Write(const T *data, size_t count)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t t = tail.load(std::memory_order_acquire);
+		if (buffer.size() - (h - t) < count)
+		{
+			return false;
+		}
+
+		size_t first = std::min(count, buffer.size() - (h & mask));
+		std::copy(data, data + first, &buffer[h & mask]);
+		std::copy(data + first, data + count, &buffer[0]);
+		head.store(h + count, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer: contiguous readable elements, valid until Consume().
+	const T *Peek(size_t &count)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_acquire);
+		count = std::min(h - t, buffer.size() - (t & mask));
+		return &buffer[t & mask];
+	}
+
+	//Consumer: releases count elements returned by Peek().
+	void Consume(size_t count)
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+
+	//Consumer: copies up to count elements, returns the number copied.
+	size_t Read(T *data, size_t count)
+	{
+		size_t done = 0;
+		while (done < count)
+		{
+			size_t n;
+			const T *p = Peek(n);
+			n = std::min(n, count - done);
+			if (n == 0)
+			{
+				break;
+			}
+			std::copy(p, p + n, data + done);
+			Consume(n);
+			done += n;
+		}
+		return done;
+	}
+
+	size_t Available()
+	{
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+	}
+};
@@ -0,0 +1,320 @@
+#include <cstdlib>
+#include <cinttypes>
+#include <cmath>
+#include <algorithm>
+#include <unistd.h>
+
+#include "SynthesisTable.h"
+
+#define TwoPi 6.283185307179586476925287
+
+uint32_t SoundscapeParameters::GetSampleCount() const
+{
+	return 2L * (uint32_t)(0.5 * sample_freq_Hz * total_time_s);
+}
+
+bool SoundscapeParameters::operator==(const SoundscapeParameters &other) const
+{
+	return (rows == other.rows) && (columns == other.columns) &&
+		(freq_lowest == other.freq_lowest) && (freq_highest == other.freq_highest) &&
+		(sample_freq_Hz == other.sample_freq_Hz) && (total_time_s == other.total_time_s) &&
+		(use_exponential == other.use_exponential) && (use_stereo == other.use_stereo) &&
+		(use_delay == other.use_delay) && (use_fade == other.use_fade) &&
+		(use_diffraction == other.use_diffraction) && (use_bspline == other.use_bspline) &&
+		(speed_of_sound_m_s == other.speed_of_sound_m_s) &&
+		(acoustical_size_of_head_m == other.acoustical_size_of_head_m) && (engine == other.engine);
+}
+
+SynthesisTable::SynthesisTable(const SoundscapeParameters &params) :
+	params(params),
+	sampleCount(params.GetSampleCount()),
+	samplesPerColumn((uint32_t)(sampleCount / params.columns)),
+	timePerSample_s(1.0 / params.sample_freq_Hz),
+	omega(std::vector<float>(params.rows)),
+	phi0(std::vector<float>(params.rows)),
+	cacheBlockCount(0)
+{
+	int rows = params.rows;
+
+	// Set lin|exp (0|1) frequency distribution and random initial phase
+	if (params.use_exponential)
+	{
+		for (int i = 0; i < rows; i++)
+		{
+			omega[i] = TwoPi * params.freq_lowest * pow(1.0 * params.freq_highest / params.freq_lowest, 1.0 * i / (rows - 1));
+		}
+	}
+	else
+	{
+		for (int i = 0; i < rows; i++)
+		{
+			omega[i] = TwoPi * params.freq_lowest + TwoPi * (params.freq_highest - params.freq_lowest) * i / (rows - 1);
+		}
+	}
+
+	//Whole number of periods per sweep, so phases continue seamlessly when sweeps follow each other, and the cache
+	//phase can be stepped exactly (see initWaveformCacheStereo()). Done in every mode, not only continuous sweeps.
+	//Moves each row by up to 0.5 / sweep time Hz: 0.48 Hz at 1.05 s, 1 Hz at 0.5 s.
+	float sweep_time_s = sampleCount * timePerSample_s;
+	for (int i = 0; i < rows; i++)
+	{
+		omega[i] = TwoPi * std::max(1.0f, roundf(omega[i] * sweep_time_s / TwoPi)) / sweep_time_s;
+	}
+
+	//Same phases for the same parameters, whichever table is built first:
+	uint32_t seed = 0;
+	for (int i = 0; i < rows; i++)
+	{
+		phi0[i] = TwoPi * rnd(seed);
+	}
+
+	pthread_mutex_init(&cacheMutex, NULL);
+	pthread_cond_init(&cacheCond, NULL);
+	if (params.engine == SynthesisEngine::Cache)
+	{
+		waveformCacheLeftChannel.resize((size_t)sampleCount * rows);
+		waveformCacheRightChannel.resize((size_t)sampleCount * rows);
+		startCacheWorkers();
+	}
+}
+
+SynthesisTable::~SynthesisTable()
+{
+	cacheQuit = true;
+	for (size_t t = 0; t < cacheThreads.size(); t++)
+	{
+		pthread_join(cacheThreads[t], nullptr);
+	}
+	pthread_cond_destroy(&cacheCond);
+	pthread_mutex_destroy(&cacheMutex);
+}
+
+std::shared_ptr<SynthesisTable> SynthesisTable::Create(const SoundscapeParameters &params, bool lazy)
+{
+	std::shared_ptr<SynthesisTable> table(new SynthesisTable(params));
+	if (!lazy)
+	{
+		table->EnsureCache(0, table->sampleCount);
+	}
+	return table;
+}
+
+SynthesisTableRegistry::SynthesisTableRegistry()
+{
+	pthread_mutex_init(&mutex, NULL);
+}
+
+SynthesisTableRegistry::~SynthesisTableRegistry()
+{
+	pthread_mutex_destroy(&mutex);
+}
+
+std::shared_ptr<SynthesisTable> SynthesisTableRegistry::Get(const SoundscapeParameters &params, bool lazy)
+{
+	std::shared_ptr<SynthesisTable> table;
+
+	pthread_mutex_lock(&mutex);
+	for (auto it = tables.begin(); it != tables.end();)
+	{
+		std::shared_ptr<SynthesisTable> entry = it->lock();
+		if (!entry)
+		{
+			it = tables.erase(it);
+			continue;
+		}
+		if (entry->GetParameters() == params)
+		{
+			table = entry;
+		}
+		++it;
+	}
+
+	//Only the cheap part is done under the lock, the cache is built by everyone who needs it:
+	if (!table)
+	{
+		table = SynthesisTable::Create(params, true);
+		tables.push_back(table);
+	}
+	pthread_mutex_unlock(&mutex);
+
+	if (!lazy)
+	{
+		table->EnsureCache(0, table->GetSampleCount());
+	}
+	return table;
+}
+
+float SynthesisTable::rnd(uint32_t &seed)
+{
+	uint32_t ia = 9301, ic = 49297, im = 233280;
+	seed = (seed*ia + ic) % im;
+	return seed / (1.0 * im);
+}
+
+uint32_t SynthesisTable::GetColumnStartSample(int column) const
+{
+	//The last column also plays the remainder of the sweep:
+	return (column >= params.columns) ? sampleCount : column * samplesPerColumn;
+}
+
+size_t SynthesisTable::GetMemoryUsage() const
+{
+	return GetMemoryUsage(params);
+}
+
+size_t SynthesisTable::GetMemoryUsage(const SoundscapeParameters &params)
+{
+	//omega, phi0 and the cache of both channels:
+	size_t cache_samples = (params.engine == SynthesisEngine::Cache) ? (2 * (size_t)params.GetSampleCount()) : 0;
+	return sizeof(float) * params.rows * (2 + cache_samples);
+}
+
+//sin(2*pi*u) for any u, error below 4e-6. Branch-free after range reduction, so the row loops vectorize.
+static inline float sinCycles(float u)
+{
+	u -= floorf(u + 0.5f); //-0.5..0.5
+	u = (u > 0.25f) ? (0.5f - u) : u;
+	u = (u < -0.25f) ? (-0.5f - u) : u; //-0.25..0.25
+	float x = (float)TwoPi * u;
+	float x2 = x * x;
+	return x * (1.0f + x2 * (-1.0f / 6 + x2 * (1.0f / 120 + x2 * (-1.0f / 5040 + x2 * (1.0f / 362880)))));
+}
+
+void *SynthesisTable::runCacheThread(void *arg)
+{
+	static_cast<SynthesisTable*>(arg)->cacheWorker();
+	return nullptr;
+}
+
+//Builds the blocks in playing order, so background workers stay ahead of the synthesis cursor.
+void SynthesisTable::cacheWorker()
+{
+	int block;
+	while (!cacheQuit && ((block = nextCacheBlock++) < cacheBlockCount))
+	{
+		buildCacheBlock(block);
+	}
+}
+
+void SynthesisTable::buildCacheBlock(int block)
+{
+	int expected = 0;
+	if (!cacheBlockState[block].compare_exchange_strong(expected, 1))
+	{
+		return;
+	}
+
+	initWaveformCacheStereo(GetColumnStartSample(block * cacheBlockColumns), GetColumnStartSample((block + 1) * cacheBlockColumns));
+
+	pthread_mutex_lock(&cacheMutex);
+	cacheBlockState[block] = 2;
+	pthread_cond_broadcast(&cacheCond);
+	pthread_mutex_unlock(&cacheMutex);
+}
+
+void SynthesisTable::EnsureCache(uint32_t first_sample, uint32_t end_sample)
+{
+	if ((first_sample >= end_sample) || (cacheBlockCount == 0))
+	{
+		return;
+	}
+
+	int first_block = std::min(first_sample / samplesPerColumn, (uint32_t)params.columns - 1) / cacheBlockColumns;
+	int last_block = std::min((end_sample - 1) / samplesPerColumn, (uint32_t)params.columns - 1) / cacheBlockColumns;
+	for (int block = first_block; block <= last_block; block++)
+	{
+		if (cacheBlockState[block] == 2)
+		{
+			continue;
+		}
+
+		buildCacheBlock(block);
+
+		pthread_mutex_lock(&cacheMutex);
+		while (cacheBlockState[block] != 2)
+		{
+			pthread_cond_wait(&cacheCond, &cacheMutex);
+		}
+		pthread_mutex_unlock(&cacheMutex);
+	}
+}
+
+//Cache blocks are independent, so they are built on all cores, by background workers and by the threads that need them.
+void SynthesisTable::startCacheWorkers()
+{
+	cacheBlockCount = (params.columns + cacheBlockColumns - 1) / cacheBlockColumns;
+	cacheBlockState.reset(new std::atomic<int>[cacheBlockCount]);
+	for (int block = 0; block < cacheBlockCount; block++)
+	{
+		cacheBlockState[block] = 0;
+	}
+	nextCacheBlock = 0;
+	cacheQuit = false;
+
+	int thread_count = std::min(std::max((int)sysconf(_SC_NPROCESSORS_ONLN) - 1, 1), 8);
+	for (int t = 0; t < thread_count; t++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, runCacheThread, this) == 0)
+		{
+			cacheThreads.push_back(thread);
+		}
+	}
+}
+
+void SynthesisTable::initWaveformCacheStereo(uint32_t first_sample, uint32_t end_sample)
+{
+	//Phases in cycles. Every row plays a whole number of periods per sweep, so the left channel phase is
+	//an exact fraction of sampleCount, stepped without accumulating rounding errors:
+	float sweep_time_s = sampleCount * timePerSample_s;
+	int rows = params.rows;
+	std::vector<uint32_t> periods(rows);
+	std::vector<uint32_t> phase(rows);
+	std::vector<float> freq(rows);
+	std::vector<float> phase0(rows);
+	std::vector<float> diffraction(rows);
+	for (int i = 0; i < rows; i++)
+	{
+		uint32_t k = (uint32_t)lrintf(omega[i] * sweep_time_s / (float)TwoPi);
+		periods[i] = k % sampleCount;
+		phase[i] = (uint32_t)(((uint64_t)k * first_sample) % sampleCount);
+		freq[i] = omega[i] / (float)TwoPi;
+		phase0[i] = phi0[i] / (float)TwoPi;
+		diffraction[i] = TwoPi * params.speed_of_sound_m_s / omega[i];
+	}
+	float cycles_per_phase_step = 1.0f / sampleCount;
+
+	for (uint32_t sample = first_sample; sample < end_sample; sample++)
+	{
+		float r = 1.0 * sample / (sampleCount - 1);  // Binaural attenuation/delay parameter
+		float theta = (r - 0.5) * TwoPi / 3;
+		float x = 0.5 * params.acoustical_size_of_head_m * (theta + sin(theta));
+		float delay_s = params.use_delay ? (x / params.speed_of_sound_m_s) : 0.0f; // Time delay model
+		x = fabs(x);
+
+		// Simple frequency-independent relative fade model
+		float fadel = params.use_fade ? (1.0 - 0.7*r) : 1.0;
+		float fader = params.use_fade ? (0.3 + 0.7*r) : 1.0;
+
+		float *left = &waveformCacheLeftChannel[sample * rows];
+		float *right = &waveformCacheRightChannel[sample * rows];
+		for (int i = 0; i < rows; i++)
+		{
+			// First order frequency-dependent azimuth diffraction model
+			float hrtf = 1.0;
+			if (params.use_diffraction && (diffraction[i] <= x))
+			{
+				hrtf = diffraction[i] / x;
+			}
+			float hrtfl = (theta < 0.0) ? fadel : (hrtf * fadel);
+			float hrtfr = (theta < 0.0) ? (hrtf * fader) : fader;
+
+			float u = phase[i] * cycles_per_phase_step + phase0[i];
+			left[i] = hrtfl * sinCycles(u);
+			right[i] = hrtfr * sinCycles(u + freq[i] * delay_s);
+
+			phase[i] += periods[i];
+			phase[i] -= (phase[i] >= sampleCount) ? sampleCount : 0;
+		}
+	}
+}
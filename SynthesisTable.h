@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <cinttypes>
+#include <pthread.h>
+
+//Time domain: oscillators from the waveform cache, cost rows x samples. FFT: inverse FFT overlap-add
+//per frame without a cache, for many rows, see FftSynthesizer.
+enum class SynthesisEngine
+{
+	Cache = 0,
+	Fft
+};
+
+struct SoundscapeParameters
+{
+	int rows;
+	int columns;
+	double freq_lowest;
+	double freq_highest;
+	int	sample_freq_Hz;
+	double total_time_s;
+	bool use_exponential;
+	bool use_stereo;
+	bool use_delay;
+	bool use_fade;
+	bool use_diffraction;
+	bool use_bspline;
+	float speed_of_sound_m_s;
+	float acoustical_size_of_head_m;
+	SynthesisEngine engine;
+
+	uint32_t GetSampleCount() const;
+	bool operator==(const SoundscapeParameters &other) const;
+	bool operator!=(const SoundscapeParameters &other) const { return !(*this == other); }
+};
+
+//Oscillator frequencies and phases with the binaural waveform cache for one set of parameters.
+//Read-only apart from building missing cache blocks, so converters with the same parameters can
+//share one table, see SynthesisTableRegistry. The cache is built in blocks of columns, by worker threads
+//that end once every block is built, and on first use. The FFT engine needs no cache.
+class SynthesisTable
+{
+private:
+	const SoundscapeParameters params;
+	const uint32_t sampleCount;
+	const uint32_t samplesPerColumn;
+	const float timePerSample_s;
+
+	std::vector<float> omega;
+	std::vector<float> phi0;
+	std::vector<float> waveformCacheLeftChannel;
+	std::vector<float> waveformCacheRightChannel;
+
+	static const int cacheBlockColumns = 8;
+	int cacheBlockCount;
+	std::unique_ptr<std::atomic<int>[]> cacheBlockState; //0: missing, 1: building, 2: ready
+	std::atomic<int> nextCacheBlock;
+	std::atomic<bool> cacheQuit;
+	std::vector<pthread_t> cacheThreads;
+	pthread_mutex_t cacheMutex;
+	pthread_cond_t cacheCond;
+
+	SynthesisTable(const SoundscapeParameters &params);
+	SynthesisTable(const SynthesisTable& other) = delete;
+	SynthesisTable& operator=(const SynthesisTable&) = delete;
+
+	static float rnd(uint32_t &seed);
+	static void *runCacheThread(void *arg);
+	void startCacheWorkers();
+	void cacheWorker();
+	void buildCacheBlock(int block);
+	void initWaveformCacheStereo(uint32_t first_sample, uint32_t end_sample);
+public:
+	~SynthesisTable();
+
+	//Returns a new table for params. lazy == false: returns once the whole cache is built.
+	static std::shared_ptr<SynthesisTable> Create(const SoundscapeParameters &params, bool lazy = false);
+
+	//Builds missing cache blocks of the sample range on the calling thread, or waits for the worker building them.
+	void EnsureCache(uint32_t first_sample, uint32_t end_sample);
+
+	//Row values of the waveform cache at sample, valid after EnsureCache() for it.
+	const float *GetLeft(uint32_t sample) const { return &waveformCacheLeftChannel[sample * params.rows]; }
+	const float *GetRight(uint32_t sample) const { return &waveformCacheRightChannel[sample * params.rows]; }
+	float GetOmega(int row) const { return omega[row]; }
+	float GetPhi0(int row) const { return phi0[row]; }
+	const SoundscapeParameters &GetParameters() const { return params; }
+	uint32_t GetSampleCount() const { return sampleCount; }
+	uint32_t GetSamplesPerColumn() const { return samplesPerColumn; }
+	uint32_t GetColumnStartSample(int column) const;
+	size_t GetMemoryUsage() const;
+	static size_t GetMemoryUsage(const SoundscapeParameters &params);
+};
+
+//Tables in use by the converters of one owner, who share a table if their parameters are equal.
+//Safe to call from several threads. Tables stay with their converters when the registry is destroyed.
+class SynthesisTableRegistry
+{
+private:
+	std::list<std::weak_ptr<SynthesisTable>> tables; //expired entries are removed on lookup
+	pthread_mutex_t mutex;
+
+	SynthesisTableRegistry(const SynthesisTableRegistry& other) = delete;
+	SynthesisTableRegistry& operator=(const SynthesisTableRegistry&) = delete;
+public:
+	SynthesisTableRegistry();
+	~SynthesisTableRegistry();
+
+	//Returns the table for params, creating it if nobody uses one. lazy == false: returns once the whole cache is built.
+	std::shared_ptr<SynthesisTable> Get(const SoundscapeParameters &params, bool lazy = false);
+};
@@ -0,0 +1,257 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#include "V4l2Capture.h"
+
+V4l2Capture::V4l2Capture() :
+	fd(-1),
+	width(0),
+	height(0),
+	bytes_per_line(0),
+	pixel_format(0),
+	held_index(-1),
+	verbose(false)
+{
+}
+
+V4l2Capture::~V4l2Capture()
+{
+	Close();
+}
+
+int V4l2Capture::xioctl(unsigned long request, void *arg)
+{
+	int r;
+	do
+	{
+		r = ioctl(fd, request, arg);
+	} while ((r == -1) && (errno == EINTR));
+	return r;
+}
+
+bool V4l2Capture::setFormat(uint32_t format, int width, int height)
+{
+	struct v4l2_format fmt;
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	fmt.fmt.pix.width = width;
+	fmt.fmt.pix.height = height;
+	fmt.fmt.pix.pixelformat = format;
+	fmt.fmt.pix.field = V4L2_FIELD_NONE;
+
+	//The driver adjusts the size to the nearest supported one:
+	if ((xioctl(VIDIOC_S_FMT, &fmt) == -1) || (fmt.fmt.pix.pixelformat != format))
+	{
+		return false;
+	}
+
+	this->width = fmt.fmt.pix.width;
+	this->height = fmt.fmt.pix.height;
+	bytes_per_line = fmt.fmt.pix.bytesperline;
+	pixel_format = format;
+	return true;
+}
+
+void V4l2Capture::setExposure(int exposure)
+{
+	struct v4l2_control ctrl;
+	memset(&ctrl, 0, sizeof(ctrl));
+	ctrl.id = V4L2_CID_EXPOSURE_AUTO;
+
+	if ((exposure < 1) || (exposure > 100))
+	{
+		ctrl.value = V4L2_EXPOSURE_APERTURE_PRIORITY;
+		xioctl(VIDIOC_S_CTRL, &ctrl);
+		return;
+	}
+
+	ctrl.value = V4L2_EXPOSURE_MANUAL;
+	xioctl(VIDIOC_S_CTRL, &ctrl);
+
+	//Map 1-100 to the range of the camera:
+	struct v4l2_queryctrl query;
+	memset(&query, 0, sizeof(query));
+	query.id = V4L2_CID_EXPOSURE_ABSOLUTE;
+	if (xioctl(VIDIOC_QUERYCTRL, &query) == 0)
+	{
+		ctrl.id = V4L2_CID_EXPOSURE_ABSOLUTE;
+		ctrl.value = query.minimum + (query.maximum - query.minimum) * (exposure - 1) / 99;
+		xioctl(VIDIOC_S_CTRL, &ctrl);
+	}
+}
+
+void V4l2Capture::Open(int device_number, int width, int height, int exposure, bool verbose)
+{
+	Close();
+	this->verbose = verbose;
+
+	std::stringstream devpath;
+	devpath << "/dev/video" << device_number;
+
+	fd = open(devpath.str().c_str(), O_RDWR | O_NONBLOCK);
+	if (fd == -1)
+	{
+		throw(std::runtime_error("Could not open " + devpath.str() + "."));
+	}
+
+	if (!setFormat(V4L2_PIX_FMT_GREY, width, height) && !setFormat(V4L2_PIX_FMT_YUYV, width, height))
+	{
+		Close();
+		throw(std::runtime_error("Camera supports neither GREY nor YUYV capture."));
+	}
+
+	setExposure(exposure);
+
+	struct v4l2_requestbuffers req;
+	memset(&req, 0, sizeof(req));
+	req.count = 4;
+	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	req.memory = V4L2_MEMORY_MMAP;
+	if ((xioctl(VIDIOC_REQBUFS, &req) == -1) || (req.count < 2))
+	{
+		Close();
+		throw(std::runtime_error("Camera does not support mmap capture buffers."));
+	}
+
+	for (uint32_t i = 0; i < req.count; i++)
+	{
+		struct v4l2_buffer buf;
+		memset(&buf, 0, sizeof(buf));
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = i;
+		if (xioctl(VIDIOC_QUERYBUF, &buf) == -1)
+		{
+			Close();
+			throw(std::runtime_error("Error querying camera buffer."));
+		}
+
+		Buffer buffer;
+		buffer.length = buf.length;
+		buffer.start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+		if (buffer.start == MAP_FAILED)
+		{
+			Close();
+			throw(std::runtime_error("Error mapping camera buffer."));
+		}
+		buffers.push_back(buffer);
+	}
+
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		queue(i);
+	}
+
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if (xioctl(VIDIOC_STREAMON, &type) == -1)
+	{
+		Close();
+		throw(std::runtime_error("Error starting camera stream."));
+	}
+
+	if (verbose)
+	{
+		std::cout << "V4L2 capture " << this->width << "x" << this->height << ((pixel_format == V4L2_PIX_FMT_GREY) ? " GREY" : " YUYV") << std::endl;
+	}
+}
+
+void V4l2Capture::Close()
+{
+	if (fd == -1)
+	{
+		return;
+	}
+
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	xioctl(VIDIOC_STREAMOFF, &type);
+
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		munmap(buffers[i].start, buffers[i].length);
+	}
+	buffers.clear();
+	held_index = -1;
+
+	close(fd);
+	fd = -1;
+}
+
+void V4l2Capture::queue(int index)
+{
+	struct v4l2_buffer buf;
+	memset(&buf, 0, sizeof(buf));
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+	if (xioctl(VIDIOC_QBUF, &buf) == -1)
+	{
+		throw(std::runtime_error("Error queueing camera buffer."));
+	}
+}
+
+//Returns buffer index, -1 if no frame is ready and wait == false.
+int V4l2Capture::dequeue(bool wait)
+{
+	while (true)
+	{
+		struct v4l2_buffer buf;
+		memset(&buf, 0, sizeof(buf));
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		if (xioctl(VIDIOC_DQBUF, &buf) == 0)
+		{
+			return buf.index;
+		}
+
+		if ((errno != EAGAIN) || !wait)
+		{
+			if (errno != EAGAIN)
+			{
+				throw(std::runtime_error("Error reading frame from camera."));
+			}
+			return -1;
+		}
+
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 2000) <= 0)
+		{
+			throw(std::runtime_error("Timeout reading frame from camera."));
+		}
+	}
+}
+
+cv::Mat V4l2Capture::Grab()
+{
+	Release();
+
+	//Skip to the newest frame, older ones go straight back to the driver:
+	int index = dequeue(true);
+	int newer;
+	while ((newer = dequeue(false)) != -1)
+	{
+		queue(index);
+		index = newer;
+	}
+	held_index = index;
+
+	int type = (pixel_format == V4L2_PIX_FMT_GREY) ? CV_8UC1 : CV_8UC2;
+	return cv::Mat(height, width, type, buffers[index].start, bytes_per_line);
+}
+
+void V4l2Capture::Release()
+{
+	if (held_index != -1)
+	{
+		queue(held_index);
+		held_index = -1;
+	}
+}
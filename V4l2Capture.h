@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cinttypes>
+#include <opencv/cv.h>
+
+//Direct V4L2 capture with mmap'd driver buffers. The camera delivers GREY or YUYV,
+//so the luma plane can be used without decoding to BGR and converting back.
+class V4l2Capture
+{
+private:
+	struct Buffer
+	{
+		void *start;
+		size_t length;
+	};
+
+	int fd;
+	std::vector<Buffer> buffers;
+	int width;
+	int height;
+	int bytes_per_line;
+	uint32_t pixel_format;
+	int held_index; //buffer handed out by Grab(), -1 if none
+	bool verbose;
+
+	V4l2Capture(const V4l2Capture& other) = delete;
+	V4l2Capture& operator=(const V4l2Capture&) = delete;
+
+	int xioctl(unsigned long request, void *arg);
+	bool setFormat(uint32_t format, int width, int height);
+	void setExposure(int exposure);
+	int dequeue(bool wait);
+	void queue(int index);
+public:
+	V4l2Capture();
+	~V4l2Capture();
+
+	//exposure: 1-100, 0 for auto.
+	void Open(int device_number, int width, int height, int exposure = 0, bool verbose = false);
+	void Close();
+	bool IsOpen() { return fd != -1; }
+
+	//Returns the newest frame as a header on the driver buffer: CV_8UC1 for GREY,
+	//CV_8UC2 for YUYV (luma in channel 0). Valid until Release() or the next Grab().
+	cv::Mat Grab();
+	//Requeues the buffer of the last Grab() to the driver.
+	void Release();
+
+	int GetWidth() { return width; }
+	int GetHeight() { return height; }
+};
@@ -0,0 +1,119 @@
+#include <cstring>
+
+#include "WavWriter.h"
+
+static void putLE16(uint8_t *p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static void putLE32(uint8_t *p, uint32_t v)
+{
+	putLE16(p, v & 0xffff);
+	putLE16(p + 2, v >> 16);
+}
+
+WavWriter::WavWriter() :
+	fp(NULL),
+	channels(0),
+	format(SampleFormat::S16),
+	data_bytes(0)
+{
+}
+
+WavWriter::~WavWriter()
+{
+	Close();
+}
+
+void WavWriter::writeHeader(uint32_t riff_size, uint32_t data_size, int sample_freq_Hz)
+{
+	int sample_bytes = GetSampleBytes(format);
+	int bytes_per_frame = sample_bytes * channels;
+	uint8_t header[44];
+
+	memcpy(header, "RIFF", 4);
+	putLE32(header + 4, riff_size);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	putLE32(header + 16, 16);
+	putLE16(header + 20, (format == SampleFormat::Float) ? 3 : 1); //IEEE float or PCM
+	putLE16(header + 22, channels);
+	putLE32(header + 24, sample_freq_Hz);
+	putLE32(header + 28, sample_freq_Hz * bytes_per_frame);
+	putLE16(header + 32, bytes_per_frame);
+	putLE16(header + 34, 8 * sample_bytes);
+	memcpy(header + 36, "data", 4);
+	putLE32(header + 40, data_size);
+
+	fwrite(header, 1, sizeof(header), fp);
+}
+
+bool WavWriter::Open(std::string filename, int sample_freq_Hz, int channels, SampleFormat format)
+{
+	Close();
+
+	fp = fopen(filename.c_str(), "wb");
+	if (fp == NULL)
+	{
+		return false;
+	}
+
+	this->channels = channels;
+	this->format = format;
+	data_bytes = 0;
+	writeHeader(0xffffffff, 0xffffffff - 36, sample_freq_Hz);
+	return !ferror(fp);
+}
+
+bool WavWriter::Write(const int16_t *samples, size_t frame_count)
+{
+	if (format != SampleFormat::S16)
+	{
+		std::vector<float> buffer(samples, samples + frame_count * channels);
+		for (size_t i = 0; i < buffer.size(); i++)
+		{
+			buffer[i] *= 1.0f / 32768.0f;
+		}
+		return Write(buffer.data(), frame_count);
+	}
+
+	size_t written = fwrite(samples, 2 * channels, frame_count, fp);
+	data_bytes += (uint64_t)written * 2 * channels;
+	return written == frame_count;
+}
+
+bool WavWriter::Write(const float *samples, size_t frame_count, uint32_t *dither_seed)
+{
+	size_t bytes_per_frame = GetSampleBytes(format) * channels;
+	convertbuffer.resize(frame_count * bytes_per_frame);
+	ConvertSamples(samples, convertbuffer.data(), frame_count * channels, format, 1.0f, dither_seed);
+
+	size_t written = fwrite(convertbuffer.data(), bytes_per_frame, frame_count, fp);
+	data_bytes += (uint64_t)written * bytes_per_frame;
+	return written == frame_count;
+}
+
+void WavWriter::Close()
+{
+	if (fp == NULL)
+	{
+		return;
+	}
+
+	//WAV sizes are 32 bit, longer files keep the open-ended header:
+	if (data_bytes <= 0xffffffffULL - 36)
+	{
+		uint8_t size[4];
+		fflush(fp);
+		fseek(fp, 4, SEEK_SET);
+		putLE32(size, (uint32_t)data_bytes + 36);
+		fwrite(size, 1, 4, fp);
+		fseek(fp, 40, SEEK_SET);
+		putLE32(size, (uint32_t)data_bytes);
+		fwrite(size, 1, 4, fp);
+	}
+
+	fclose(fp);
+	fp = NULL;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cinttypes>
+
+#include "SampleConversion.h"
+
+//Writes PCM WAV files (16, 24 or 32-bit integer, 32-bit float) in a streaming fashion: the header is written first with
+//open-ended sizes (readable up to the end if the program dies) and patched on Close().
+class WavWriter
+{
+private:
+	FILE *fp;
+	int channels;
+	SampleFormat format;
+	uint64_t data_bytes;
+	std::vector<uint8_t> convertbuffer;
+
+	WavWriter(const WavWriter& other) = delete;
+	WavWriter& operator=(const WavWriter&) = delete;
+
+	void writeHeader(uint32_t riff_size, uint32_t data_size, int sample_freq_Hz);
+public:
+	WavWriter();
+	~WavWriter();
+
+	bool Open(std::string filename, int sample_freq_Hz, int channels, SampleFormat format = SampleFormat::S16);
+	//Interleaved frames, converted to the file format. dither_seed: see ConvertSamples().
+	bool Write(const int16_t *samples, size_t frame_count);
+	bool Write(const float *samples, size_t frame_count, uint32_t *dither_seed = nullptr);
+	void Close();
+	bool IsOpen() { return fp != NULL; }
+	uint64_t GetFrameCount() { return (channels > 0) ? data_bytes / (GetSampleBytes(format) * channels) : 0; }
+};
@@ -15,7 +15,7 @@ OBJCOPY := objcopy
 PREPROCESSOR_MACROS := DEBUG
 INCLUDE_DIRS := \usr\local\include
 LIBRARY_DIRS := \usr\local\lib \opt\vc\lib
-LIBRARY_NAMES := rt opencv_core opencv_highgui opencv_imgproc raspicam_cv raspicam ncurses pthread wiringPi
+LIBRARY_NAMES := rt opencv_core opencv_highgui opencv_imgproc raspicam_cv raspicam ncurses pthread wiringPi espeak asound
 ADDITIONAL_LINKER_INPUTS := 
 MACOS_FRAMEWORKS := 
 LINUX_PACKAGES := 
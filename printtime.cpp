@@ -11,3 +11,17 @@ void printtime(std::string msg)
 	}
 	time = newtime;
 }
+
+StageTimer::StageTimer()
+{
+	clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+double StageTimer::Lap()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double ms = (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) * 1.0e-6;
+	start = now;
+	return ms;
+}
@@ -6,3 +6,14 @@
 #include <iostream>
 
 void printtime(std::string msg);
+
+//Wall clock stopwatch for per-stage timings.
+class StageTimer
+{
+private:
+	struct timespec start;
+public:
+	StageTimer();
+	//ms since construction or the previous Lap(), restarts the timer.
+	double Lap();
+};
@@ -0,0 +1,195 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "soundscape.h"
+#include "ImageToSoundscape.h"
+
+struct soundscape
+{
+	ImageToSoundscapeConverter converter;
+
+	soundscape(const SoundscapeParameters &params, bool lazy_cache, SynthesisTableRegistry *registry) :
+		converter(params, lazy_cache, registry)
+	{
+	}
+};
+
+struct soundscape_context
+{
+	SynthesisTableRegistry tables;
+};
+
+static SoundscapeParameters toSoundscapeParameters(const soundscape_params_t *params)
+{
+	SoundscapeParameters p;
+	p.rows = params->rows;
+	p.columns = params->columns;
+	p.freq_lowest = params->freq_lowest;
+	p.freq_highest = params->freq_highest;
+	p.sample_freq_Hz = params->sample_freq_Hz;
+	p.total_time_s = params->total_time_s;
+	p.use_exponential = (params->use_exponential != 0);
+	p.use_stereo = (params->use_stereo != 0);
+	p.use_delay = (params->use_delay != 0);
+	p.use_fade = (params->use_fade != 0);
+	p.use_diffraction = (params->use_diffraction != 0);
+	p.use_bspline = (params->use_bspline != 0);
+	p.speed_of_sound_m_s = params->speed_of_sound_m_s;
+	p.acoustical_size_of_head_m = params->acoustical_size_of_head_m;
+	p.engine = (params->synthesis_engine == 1) ? SynthesisEngine::Fft : SynthesisEngine::Cache;
+	return p;
+}
+
+static bool isValid(const soundscape_params_t *params)
+{
+	return (params != NULL) && (params->rows >= 2) && (params->columns >= 1) && (params->freq_lowest > 0.0) &&
+		(params->freq_highest > params->freq_lowest) && (params->sample_freq_Hz > 0) && (params->use_stereo != 0) &&
+		(toSoundscapeParameters(params).GetSampleCount() >= 2 * (uint32_t)params->columns);
+}
+
+void soundscape_default_params(soundscape_params_t *params)
+{
+	params->rows = 64;
+	params->columns = 176;
+	params->freq_lowest = 500;
+	params->freq_highest = 5000;
+	params->sample_freq_Hz = 48000;
+	params->total_time_s = 1.05;
+	params->use_exponential = 1;
+	params->use_stereo = 1;
+	params->use_delay = 1;
+	params->use_fade = 1;
+	params->use_diffraction = 1;
+	params->use_bspline = 1;
+	params->speed_of_sound_m_s = 340;
+	params->acoustical_size_of_head_m = 0.20;
+	params->lazy_cache = 0;
+	params->synthesis_engine = 0;
+}
+
+size_t soundscape_memory_bytes(const soundscape_params_t *params)
+{
+	if (!isValid(params))
+	{
+		return 0;
+	}
+	return ImageToSoundscapeConverter::GetMemoryUsage(toSoundscapeParameters(params)) + sizeof(soundscape_t);
+}
+
+soundscape_context_t *soundscape_context_create(void)
+{
+	try
+	{
+		return new soundscape_context_t();
+	}
+	catch (std::exception &e)
+	{
+		return NULL;
+	}
+}
+
+void soundscape_context_destroy(soundscape_context_t *context)
+{
+	delete context;
+}
+
+soundscape_t *soundscape_create(const soundscape_params_t *params, soundscape_context_t *context)
+{
+	if (!isValid(params))
+	{
+		return NULL;
+	}
+
+	try
+	{
+		return new soundscape_t(toSoundscapeParameters(params), params->lazy_cache != 0, (context != NULL) ? &context->tables : nullptr);
+	}
+	catch (std::exception &e)
+	{
+		return NULL;
+	}
+}
+
+void soundscape_destroy(soundscape_t *soundscape)
+{
+	delete soundscape;
+}
+
+int soundscape_get_frame_count(const soundscape_t *soundscape)
+{
+	return soundscape->converter.GetFrameCount();
+}
+
+int soundscape_get_channels(const soundscape_t *soundscape)
+{
+	return soundscape->converter.GetChannels();
+}
+
+int soundscape_get_sample_freq(const soundscape_t *soundscape)
+{
+	return soundscape->converter.GetSampleFreq();
+}
+
+double soundscape_get_latency_s(const soundscape_t *soundscape)
+{
+	return (double)soundscape->converter.GetFrameCount() / soundscape->converter.GetSampleFreq();
+}
+
+size_t soundscape_get_memory_usage(const soundscape_t *soundscape)
+{
+	return soundscape->converter.GetMemoryUsage() + sizeof(soundscape_t);
+}
+
+void soundscape_image_from_gray8(const soundscape_t *soundscape, const uint8_t *pixels, int stride, float *image)
+{
+	SoundscapeParameters params = soundscape->converter.GetParameters();
+
+	float lut[16];
+	lut[0] = 0.0;
+	for (int m = 1; m < 16; m++)
+	{
+		lut[m] = pow(10.0, (m - 15) / 10.0);   // 2dB steps
+	}
+
+	for (int y = 0; y < params.rows; y++)
+	{
+		const uint8_t *p = pixels + y * stride;
+		int i = params.rows - 1 - y;
+		for (int j = 0; j < params.columns; j++)
+		{
+			image[j * params.rows + i] = lut[p[j] / 16];
+		}
+	}
+}
+
+template<typename T>
+static int render(soundscape_t *soundscape, const float *images, int image_count, T *samples)
+{
+	ImageToSoundscapeConverter &converter = soundscape->converter;
+	SoundscapeParameters params = converter.GetParameters();
+	size_t image_size = (size_t)params.rows * params.columns;
+	size_t soundscape_size = (size_t)converter.GetFrameCount() * converter.GetChannels();
+
+	try
+	{
+		for (int n = 0; n < image_count; n++)
+		{
+			converter.Process(images + n * image_size, samples + n * soundscape_size);
+		}
+	}
+	catch (std::exception &e)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+int soundscape_render_s16(soundscape_t *soundscape, const float *images, int image_count, int16_t *samples)
+{
+	return render(soundscape, images, image_count, samples);
+}
+
+int soundscape_render_f32(soundscape_t *soundscape, const float *images, int image_count, float *samples)
+{
+	return render(soundscape, images, image_count, samples);
+}
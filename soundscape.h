@@ -0,0 +1,75 @@
+#pragma once
+
+//C interface of the synthesis engine, built as libsoundscape (make lib) without audio, camera or UI dependencies.
+//The library has no global state. Every soundscape_t may be used from its own thread. Converters created with the
+//same soundscape_context_t share their read-only waveform cache if their parameters are equal, so many of them
+//cost little extra memory.
+//Threads: building the waveform cache starts up to 8 worker threads (one less than the cores), which end once the
+//cache is complete. With lazy_cache, they go on building in the background after soundscape_create() returns.
+//They are stopped and joined when the last converter using the cache is destroyed. The FFT engine starts none.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct soundscape soundscape_t;
+typedef struct soundscape_context soundscape_context_t;
+
+typedef struct
+{
+	int rows;
+	int columns;
+	double freq_lowest;
+	double freq_highest;
+	int sample_freq_Hz;
+	double total_time_s;
+	int use_exponential;
+	int use_stereo; //only stereo is implemented
+	int use_delay;
+	int use_fade;
+	int use_diffraction;
+	int use_bspline;
+	float speed_of_sound_m_s;
+	float acoustical_size_of_head_m;
+	int lazy_cache; //return from soundscape_create() before the cache is complete
+	int synthesis_engine; //0: time domain with waveform cache, 1: FFT overlap-add without cache, for many rows
+} soundscape_params_t;
+
+//Defaults of raspivoice: 64x176, 500-5000 Hz, 48 kHz, 1.05 s.
+void soundscape_default_params(soundscape_params_t *params);
+
+//Memory needed by a converter with these parameters, if no other converter shares its cache.
+size_t soundscape_memory_bytes(const soundscape_params_t *params);
+
+//Sharing of waveform caches between converters. May be used from several threads, and destroyed before its converters.
+soundscape_context_t *soundscape_context_create(void);
+void soundscape_context_destroy(soundscape_context_t *context);
+
+//context: shares the cache with its converters, NULL for a cache of its own.
+//Returns NULL on invalid parameters or if out of memory.
+soundscape_t *soundscape_create(const soundscape_params_t *params, soundscape_context_t *context);
+void soundscape_destroy(soundscape_t *soundscape);
+
+//Every image gives frame_count frames of interleaved samples.
+int soundscape_get_frame_count(const soundscape_t *soundscape);
+int soundscape_get_channels(const soundscape_t *soundscape);
+int soundscape_get_sample_freq(const soundscape_t *soundscape);
+//Time from the start of a soundscape until its last column is heard, the image-to-sound latency of the output.
+double soundscape_get_latency_s(const soundscape_t *soundscape);
+size_t soundscape_get_memory_usage(const soundscape_t *soundscape);
+
+//Converts an 8-bit grayscale image of rows x columns (top row first, stride in bytes) into the engine's image:
+//columns x rows floats, column-major with row 0 at the bottom, 16 brightness levels in 2 dB steps.
+void soundscape_image_from_gray8(const soundscape_t *soundscape, const uint8_t *pixels, int stride, float *image);
+
+//Renders image_count images, each rows * columns floats in the engine's layout, into consecutive soundscapes
+//of frame_count * channels samples. Float samples are not clipped. Returns 0, or -1 on error.
+int soundscape_render_s16(soundscape_t *soundscape, const float *images, int image_count, int16_t *samples);
+int soundscape_render_f32(soundscape_t *soundscape, const float *images, int image_count, float *samples);
+
+#ifdef __cplusplus
+}
+#endif